@@ -1,8 +1,9 @@
 // ai_tycoon.cpp
 // A minimal console prototype of "AI Tycoon – The Business Brain"
-// C++17, no external deps. Compile: g++ -std=gnu++17 -O2 ai_tycoon.cpp -o ai_tycoon
+// C++17, no external deps. Compile: g++ -std=gnu++17 -O2 -ffp-contract=off -pthread ai_tycoon.cpp -o ai_tycoon
 
 #include <iomanip>
+#include <limits>
 #include <random>
 #include <iostream>
 #include <vector>
@@ -10,6 +11,47 @@
 #include <string>
 #include <map>
 #include <set>
+#include <sstream>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <csignal>
+#include <cmath>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <stdexcept>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#define AITYCOON_HAVE_IO_URING 1
+#else
+#define AITYCOON_HAVE_IO_URING 0
+#endif
 using namespace std;
 using namespace std;
 
@@ -34,27 +76,220 @@ struct Snapshot {
     double profit;
 };
 
-static std::mt19937_64 rng(12345);
+using Rng = std::mt19937_64;
+
+// Small-state generator (xoshiro256**) for places that hold many streams at once
+class FastRng {
+public:
+    using result_type = uint64_t;
+    FastRng() : FastRng(1) {}
+    explicit FastRng(uint64_t seed) {
+        for (auto& w : s) {
+            seed += 0x9E3779B97F4A7C15ull;
+            uint64_t z = seed;
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+            w = z ^ (z >> 31);
+        }
+    }
+    static constexpr result_type min() { return 0; }
+    static constexpr result_type max() { return ~0ull; }
+    result_type operator()() {
+        uint64_t r = rotl(s[1] * 5, 7) * 9;
+        uint64_t t = s[1] << 17;
+        s[2] ^= s[0]; s[3] ^= s[1]; s[1] ^= s[2]; s[0] ^= s[3];
+        s[2] ^= t;
+        s[3] = rotl(s[3], 45);
+        return r;
+    }
+private:
+    uint64_t s[4];
+    static uint64_t rotl(uint64_t x, int k) { return (x << k) | (x >> (64 - k)); }
+};
 
 // Clamps for safety
 template<class T> T clampv(T v, T lo, T hi) { return max(lo, min(hi, v)); }
 
+// ---------- Portable Math ----------
+// libm and the standard distributions differ between platforms (glibc vs
+// Apple libm, libstdc++ vs libc++ normal_distribution), so one seed could
+// play different games on different hosts. The simulation therefore uses
+// these in-tree versions, built only from IEEE basic operations (+ - * /
+// sqrt), which are exact everywhere: log and exp follow fdlibm, log1p uses
+// Goldberg's log(1+x) * x / ((1+x) - 1), normals come from a ziggurat built
+// on them. floor and round are exact and stay as they are.
+// Bit-identical results also need no fused multiply-add contraction: clang
+// honours the pragma below, GCC needs -ffp-contract=off on FMA targets
+// (arm64, or x86 with -mfma). Build with -DAITYCOON_PLATFORM_MATH=1 to get
+// the platform functions back.
+#ifdef __clang__
+#pragma STDC FP_CONTRACT OFF
+#endif
+#ifndef AITYCOON_PLATFORM_MATH
+#define AITYCOON_PLATFORM_MATH 0
+#endif
+
+inline uint64_t doubleBits(double x) { uint64_t b; memcpy(&b, &x, sizeof b); return b; }
+inline double bitsDouble(uint64_t b) { double x; memcpy(&x, &b, sizeof x); return x; }
+
+inline double portableLog(double x) {
+    const double ln2Hi = 6.93147180369123816490e-01, ln2Lo = 1.90821492927058770002e-10;
+    const double Lg1 = 6.666666666666735130e-01, Lg2 = 3.999999999940941908e-01, Lg3 = 2.857142874366239149e-01,
+                 Lg4 = 2.222219843214978396e-01, Lg5 = 1.818357216161805012e-01, Lg6 = 1.531383769920937332e-01,
+                 Lg7 = 1.479819860511658591e-01;
+    uint64_t b = doubleBits(x);
+    int32_t hx = (int32_t)(b >> 32);
+    int k = 0;
+    if (hx < 0x00100000) {                        // negative, zero or subnormal
+        if ((b & ~(1ull << 63)) == 0) return -numeric_limits<double>::infinity();
+        if (hx < 0) return numeric_limits<double>::quiet_NaN();
+        k -= 54;
+        x *= 18014398509481984.0;                // 2^54
+        b = doubleBits(x);
+        hx = (int32_t)(b >> 32);
+    }
+    if (hx >= 0x7ff00000) return x + x;          // inf or NaN
+    k += (hx >> 20) - 1023;
+    hx &= 0x000fffff;
+    int32_t i = (hx + 0x95f64) & 0x100000;
+    // x scaled into [sqrt(2)/2, sqrt(2))
+    x = bitsDouble(((uint64_t)(uint32_t)(hx | (i ^ 0x3ff00000)) << 32) | (b & 0xffffffffull));
+    k += i >> 20;
+    double f = x - 1.0;
+    double s = f / (2.0 + f), dk = (double)k;
+    double z = s * s, w = z * z;
+    double t1 = w * (Lg2 + w * (Lg4 + w * Lg6));
+    double t2 = z * (Lg1 + w * (Lg3 + w * (Lg5 + w * Lg7)));
+    double R = t2 + t1;
+    if (((hx - 0x6147a) | (0x6b851 - hx)) > 0) {
+        double hfsq = 0.5 * f * f;
+        return dk * ln2Hi - ((hfsq - (s * (hfsq + R) + dk * ln2Lo)) - f);
+    }
+    return dk * ln2Hi - ((s * (f - R) - dk * ln2Lo) - f);
+}
+
+inline double portableLog1p(double x) {
+    double u = 1.0 + x;
+    if (u == 1.0) return x;                      // log(1 + x) == x to working precision
+    if (u == numeric_limits<double>::infinity()) return u;
+    return portableLog(u) * (x / (u - 1.0));
+}
+
+inline double portableExp(double x) {
+    const double ln2Hi = 6.93147180369123816490e-01, ln2Lo = 1.90821492927058770002e-10,
+                 invLn2 = 1.44269504088896338700e+00;
+    const double P1 = 1.66666666666666019037e-01, P2 = -2.77777777770155933842e-03, P3 = 6.61375632143793436117e-05,
+                 P4 = -1.65339022054652515390e-06, P5 = 4.13813679705723846039e-08;
+    if (!(x <= 709.782712893383973096)) return x + numeric_limits<double>::infinity(); // inf, or NaN stays NaN
+    if (x < -745.13321910194110842) return 0.0;
+    // adding 1.5 * 2^52 rounds x / ln2 to the nearest integer, left in the low bits
+    const double shift = 6755399441055744.0;
+    double kd = x * invLn2 + shift;
+    int k = (int32_t)doubleBits(kd);
+    kd -= shift;
+    double hi = x - kd * ln2Hi, lo = kd * ln2Lo;
+    x = hi - lo;
+    double t = x * x;
+    double c = x - t * (P1 + t * (P2 + t * (P3 + t * (P4 + t * P5))));
+    double y = 1.0 - ((lo - (x * c) / (2.0 - c)) - hi);
+    // y * 2^k, in two steps near the ends of the range
+    if (k >= -1021 && k <= 1023) return y * bitsDouble((uint64_t)(1023 + k) << 52);
+    if (k > 0) return y * 2.0 * bitsDouble((uint64_t)(1023 + 1023) << 52);
+    return y * bitsDouble((uint64_t)(1023 + k + 1000) << 52) * bitsDouble((uint64_t)(1023 - 1000) << 52);
+}
+
+// Uniform in [0, 1) from the top 53 bits of a 64-bit engine
+template<class G>
+double portableUniform(G& rng) {
+    static_assert(G::min() == 0 && G::max() == ~0ull, "portableUniform needs a full 64-bit engine");
+    return (double)(rng() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+// Ziggurat (Marsaglia and Tsang 2000, in Doornik's 2005 form) with 128
+// equal-area layers. The tables are built once from the functions above, so
+// they match on every host. One engine draw gives both the layer (low 7 bits)
+// and the uniform (top 53 bits); about 99% of draws need nothing more.
+struct ZigguratTables {
+    static constexpr int kLayers = 128;
+    static constexpr double kR = 3.442619855899, kArea = 9.91256303526217e-3;
+    double x[kLayers + 1], ratio[kLayers];
+
+    ZigguratTables() {
+        auto f = [](double t) { return portableExp(-0.5 * t * t); };
+        x[0] = kArea / f(kR);
+        x[1] = kR;
+        for (int i = 2; i < kLayers; ++i) x[i] = sqrt(-2.0 * portableLog(kArea / x[i - 1] + f(x[i - 1])));
+        x[kLayers] = 0.0;
+        for (int i = 0; i < kLayers; ++i) ratio[i] = x[i + 1] / x[i];
+    }
+};
+
+template<class G>
+double portableNormal(G& rng, double mean, double stddev) {
+    static const ZigguratTables z;
+    for (;;) {
+        uint64_t b = rng();
+        double u = 2.0 * ((double)(b >> 11) * (1.0 / 9007199254740992.0)) - 1.0;
+        int i = (int)(b & (ZigguratTables::kLayers - 1));
+        if (fabs(u) < z.ratio[i]) return mean + stddev * u * z.x[i];
+        if (i == 0) {
+            // base layer: sample the tail beyond kR
+            double a, t;
+            do {
+                a = -portableLog(1.0 - portableUniform(rng)) / ZigguratTables::kR;
+                t = -portableLog(1.0 - portableUniform(rng));
+            } while (t + t < a * a);
+            return mean + stddev * (u < 0.0 ? -(ZigguratTables::kR + a) : ZigguratTables::kR + a);
+        }
+        double x0 = u * z.x[i];
+        double f0 = portableExp(-0.5 * (z.x[i] * z.x[i] - x0 * x0));
+        double f1 = portableExp(-0.5 * (z.x[i + 1] * z.x[i + 1] - x0 * x0));
+        if (f1 + portableUniform(rng) * (f0 - f1) < 1.0) return mean + stddev * x0;
+    }
+}
+
+// What the simulation calls
+#if AITYCOON_PLATFORM_MATH
+inline double simLog1p(double x) { return log1p(x); }
+inline double simExp(double x) { return exp(x); }
+template<class G> double simUniform(G& rng) { return uniform_real_distribution<double>(0.0, 1.0)(rng); }
+template<class G> double simNormal(G& rng, double mean, double stddev) { return normal_distribution<double>(mean, stddev)(rng); }
+#else
+inline double simLog1p(double x) { return portableLog1p(x); }
+inline double simExp(double x) { return portableExp(x); }
+template<class G> double simUniform(G& rng) { return portableUniform(rng); }
+template<class G> double simNormal(G& rng, double mean, double stddev) { return portableNormal(rng, mean, stddev); }
+#endif
+
 // ---------- Market Events ----------
 struct MarketEvent {
-    string name;
+    const char* name;
     double baseShock;   // affects baseline demand
     double adShock;     // multiplier on ad effectiveness
     double priceShock;  // multiplier on price sensitivity
 };
 
-MarketEvent drawEvent(int week) {
-    uniform_real_distribution<double> u(0.0, 1.0);
-    double r = u(rng);
-    if (r < 0.10) return {"Viral Trend", +20.0, +0.50, -0.10};
-    if (r < 0.20) return {"New Competitor", -15.0, -0.10, +0.25};
-    if (r < 0.30) return {"Supply News (positive)", +5.0, +0.05, -0.05};
-    if (r < 0.40) return {"Macro Slump", -10.0, -0.10, +0.15};
-    return {"Nothing Special", 0.0, 0.0, 0.0};
+// Event menu with cumulative draw thresholds
+struct EventOdds {
+    double upTo;
+    MarketEvent ev;
+};
+
+constexpr EventOdds kEventTable[] = {
+    {0.10, {"Viral Trend", +20.0, +0.50, -0.10}},
+    {0.20, {"New Competitor", -15.0, -0.10, +0.25}},
+    {0.30, {"Supply News (positive)", +5.0, +0.05, -0.05}},
+    {0.40, {"Macro Slump", -10.0, -0.10, +0.15}},
+    {1.00, {"Nothing Special", 0.0, 0.0, 0.0}},
+};
+constexpr int kEventKinds = sizeof(kEventTable) / sizeof(kEventTable[0]);
+
+template<class G>
+MarketEvent drawEvent(int week, G& rng) {
+    double r = simUniform(rng);
+    for (const EventOdds& e : kEventTable)
+        if (r < e.upTo) return e.ev;
+    return kEventTable[kEventKinds - 1].ev;
 }
 
 // ---------- Company ----------
@@ -72,22 +307,46 @@ struct Company {
 };
 
 // ---------- AI Advisor (online linear model) ----------
+struct AdvisorWeights {
+    double w0, wP, wA, wB, wI;
+};
+
 // Model: demand_hat = w0 + wP*( -price ) + wA*log(1+ad) + wB*baseProxy + wI*inventoryAvail
 // where baseProxy is a noisy public proxy the player and AI see (moving avg of sales)
+struct AdvisorConfig {
+    // initialize weights with small priors
+    AdvisorWeights prior{
+        40.0,   // baseline demand guess
+        1.0,    // price sensitivity (higher price -> lower demand, so we apply minus)
+        8.0,    // ad effectiveness on log scale
+        0.5,    // belief in base signal
+        0.1     // inventory availability small boost
+    };
+    double learningRate = 0.0015; // learning rate for SGD
+};
+
 class AIAdvisor {
 public:
-    AIAdvisor() {
-        // initialize weights with small priors
-        w0 = 40.0;   // baseline demand guess
-        wP = 1.0;    // price sensitivity (higher price -> lower demand, so we apply minus)
-        wA = 8.0;    // ad effectiveness on log scale
-        wB = 0.5;    // belief in base signal
-        wI = 0.1;    // inventory availability small boost
-        lr = 0.0015; // learning rate for SGD
+    AIAdvisor() : AIAdvisor(AdvisorConfig()) {}
+
+    explicit AIAdvisor(const AdvisorConfig& cfg) {
+        w0 = cfg.prior.w0;
+        wP = cfg.prior.wP;
+        wA = cfg.prior.wA;
+        wB = cfg.prior.wB;
+        wI = cfg.prior.wI;
+        lr = cfg.learningRate;
     }
 
     // Suggest plan via simple grid search to maximize predicted profit
     Plan suggest(const Company& c, double baseProxy, double eventAdMult, double eventPriceMult) {
+        return suggestFor(weights(), c.inventory, c.unitCost, c.fixedCost, baseProxy, eventAdMult, eventPriceMult);
+    }
+
+    // Same search for callers that keep weights and inventory outside a Company
+    static Plan suggestFor(const AdvisorWeights& w, int inventory, double unitCost, double fixedCost,
+                           double baseProxy, double eventAdMult, double eventPriceMult)
+    {
         // sane bounds
         double bestProfit = -1e18;
         Plan best{20, 1000, 50};
@@ -96,10 +355,10 @@ public:
         for (double price = 9.0; price <= 40.0; price += 1.0) {
             for (double ad = 0.0; ad <= 8000.0; ad += 500.0) {
                 for (int prod = 0; prod <= 120; prod += 10) {
-                    double demandHat = predict(price, ad, baseProxy, c.inventory + prod, eventAdMult, eventPriceMult);
-                    int canSell = min((int)round(demandHat), c.inventory + prod);
+                    double demandHat = predictWith(w, price, ad, baseProxy, inventory + prod, eventAdMult, eventPriceMult);
+                    int canSell = min((int)round(demandHat), inventory + prod);
                     double revenue = canSell * price;
-                    double cost = prod * c.unitCost + ad + c.fixedCost;
+                    double cost = prod * unitCost + ad + fixedCost;
                     double profit = revenue - cost;
                     if (profit > bestProfit) {
                         bestProfit = profit;
@@ -118,19 +377,21 @@ public:
         // Features
         double x0 = 1.0;
         double xP = - price * (1.0 + eventPriceMult); // higher -> less demand
-        double xA = log1p(ad) * (1.0 + eventAdMult);
+        double xA = simLog1p(ad) * (1.0 + eventAdMult);
         double xB = baseProxy;
         double xI = (double)inventoryAvail;
 
         double yhat = w0*x0 + wP*xP + wA*xA + wB*xB + wI*xI;
         double err = (double)sold - yhat;
 
-        // SGD update
-        w0 += lr * err * x0;
-        wP += lr * err * xP;
-        wA += lr * err * xA;
-        wB += lr * err * xB;
-        wI += lr * err * xI;
+        // SGD update (faster for a while after a detected regime change)
+        double rate = lr;
+        if (boostWeeks > 0) { --boostWeeks; rate *= boost; }
+        w0 += rate * err * x0;
+        wP += rate * err * xP;
+        wA += rate * err * xA;
+        wB += rate * err * xB;
+        wI += rate * err * xI;
 
         // keep weights in reasonable ranges to prevent explosions
         w0 = clampv(w0, -200.0, 300.0);
@@ -148,112 +409,211 @@ public:
              << ", wB=" << wB << ", wI=" << wI << "\n";
     }
 
+    AdvisorWeights weights() const { return {w0, wP, wA, wB, wI}; }
+
+    // Weight the next few observations more: the market just changed
+    void emphasizeRecent(int weeks, double factor) {
+        boostWeeks = weeks;
+        boost = factor;
+    }
+
 private:
     double w0, wP, wA, wB, wI; // weights
     double lr;
+    int boostWeeks = 0;
+    double boost = 1.0;
 
-    double predict(double price, double ad, double baseProxy, int inventoryAvail,
-                   double eventAdMult, double eventPriceMult) const
+    static double predictWith(const AdvisorWeights& w, double price, double ad, double baseProxy,
+                              int inventoryAvail, double eventAdMult, double eventPriceMult)
     {
         double x0 = 1.0;
         double xP = - price * (1.0 + eventPriceMult);
-        double xA = log1p(ad) * (1.0 + eventAdMult);
+        double xA = simLog1p(ad) * (1.0 + eventAdMult);
         double xB = baseProxy;
         double xI = (double)inventoryAvail;
-        double yhat = w0*x0 + wP*xP + wA*xA + wB*xB + wI*xI;
+        double yhat = w.w0*x0 + w.wP*xP + w.wA*xA + w.wB*xB + w.wI*xI;
         return max(0.0, yhat);
     }
 };
 
 // ---------- Market Simulation ----------
-struct Market {
-    // Hidden true parameters (player/AI sees only effects)
+// The market is assembled from policies: how the baseline drifts, how plans
+// turn into expected demand, what noise is added and where events come from.
+// Policies are base classes, so their parameters read as market fields
+// (mk.baseDemand, mk.priceSensitivity, ...) and every call is resolved at
+// compile time. `Market` is the game's original model.
+
+// Baseline random walk with a floor
+struct RandomWalkDrift {
     double baseDemand = 60.0;        // starts at 60
-    double priceSensitivity = 1.4;   // demand drop per $ increase
-    double adEffect = 9.0;           // demand lift per log-dollar
     double demandDrift = 0.2;        // weekly drift of baseline (could be +/-)
-    double noiseStd = 6.0;
+    double driftStd = 0.8;
 
     // Evolve baseline a tad each week
-    void drift() {
-        normal_distribution<double> n(0.0, 0.8);
-        baseDemand = max(5.0, baseDemand + demandDrift + n(rng));
+    template<class G>
+    void drift(G& rng) {
+        baseDemand = max(5.0, baseDemand + demandDrift + simNormal(rng, 0.0, driftStd));
     }
+};
 
-    // Realized demand function
-    int realizeDemand(double price, double adSpend, const MarketEvent& ev, int inventoryAvail) {
-        // True generative process (unknown to AI)
+// Baseline pulled back toward a long-run level instead of trending
+struct MeanRevertingDrift {
+    double baseDemand = 60.0;
+    double longRunDemand = 60.0;
+    double reversion = 0.15;         // fraction of the gap closed per week
+    double driftStd = 0.8;
+
+    template<class G>
+    void drift(G& rng) {
+        baseDemand = max(5.0, baseDemand + reversion * (longRunDemand - baseDemand) + simNormal(rng, 0.0, driftStd));
+    }
+};
+
+// Linear in price, logarithmic in ad spend
+struct LinearLogDemand {
+    double priceSensitivity = 1.4;   // demand drop per $ increase
+    double adEffect = 9.0;           // demand lift per log-dollar
+
+    double meanDemand(double baseDemand, double price, double adSpend, const MarketEvent& ev, int inventoryAvail) const {
         double priceMult = 1.0 + ev.priceShock;
         double adMult = 1.0 + ev.adShock;
+        return baseDemand + ev.baseShock
+               - priceSensitivity * price * priceMult
+               + adEffect * simLog1p(adSpend) * adMult
+               + 0.08 * (double)inventoryAvail; // availability slightly boosts conversion
+    }
+};
 
-        double mu = baseDemand + ev.baseShock
-                    - priceSensitivity * price * priceMult
-                    + adEffect * log1p(adSpend) * adMult
-                    + 0.08 * (double)inventoryAvail; // availability slightly boosts conversion
+struct GaussianNoise {
+    double noiseStd = 6.0;
+
+    template<class G>
+    double sample(G& rng, double scale = 1.0) {
+        return simNormal(rng, 0.0, noiseStd * scale);
+    }
+};
+
+// Expected-value dynamics: no demand noise
+struct NoNoise {
+    template<class G>
+    double sample(G&, double = 1.0) { return 0.0; }
+};
+
+struct DefaultEvents {
+    template<class G>
+    MarketEvent nextEvent(int week, G& rng) { return drawEvent(week, rng); }
+};
 
-        normal_distribution<double> n(0.0, noiseStd);
-        double demand = max(0.0, mu + n(rng));
+struct NoEvents {
+    template<class G>
+    MarketEvent nextEvent(int, G&) { return {"Nothing Special", 0.0, 0.0, 0.0}; }
+};
+
+// Analytic event averaging: every week brings the probability-weighted mean
+// event. Mean demand is linear in each shock, so this is its expectation
+// (before the floor at zero and the stock limit).
+struct ExpectedEvents {
+    template<class G>
+    MarketEvent nextEvent(int, G&) { return meanEvent(); }
+
+    static MarketEvent meanEvent() {
+        MarketEvent m{"Expected Event", 0.0, 0.0, 0.0};
+        double prev = 0.0;
+        for (const EventOdds& e : kEventTable) {
+            double p = e.upTo - prev;
+            prev = e.upTo;
+            m.baseShock += p * e.ev.baseShock;
+            m.adShock += p * e.ev.adShock;
+            m.priceShock += p * e.ev.priceShock;
+        }
+        return m;
+    }
+};
+
+template<class DriftModel, class DemandModel, class NoiseModel, class EventSource>
+struct BasicMarket : DriftModel, DemandModel, NoiseModel, EventSource {
+    // Realized demand function
+    template<class G>
+    int realizeDemand(double price, double adSpend, const MarketEvent& ev, int inventoryAvail, G& rng) {
+        // True generative process (unknown to AI)
+        double mu = this->meanDemand(this->baseDemand, price, adSpend, ev, inventoryAvail);
+        double demand = max(0.0, mu + this->sample(rng));
         return (int)floor(demand + 0.5);
     }
+
+    // Several sellers in one market: category demand is the sum of their
+    // standalone demands plus shared noise, split by a softmax over those
+    // standalone demands (closer competitors split more evenly).
+    template<class G>
+    void realizeSharedDemand(int sellers, const Plan* plans, const int* inventoryAvail,
+                             const MarketEvent& ev, G& rng, int* demandOut)
+    {
+        const double temperature = 10.0; // demand units per e-fold of share
+        double mu[8], pool = 0.0, top = -1e300;
+        sellers = min(sellers, 8);
+        for (int s = 0; s < sellers; ++s) {
+            mu[s] = this->meanDemand(this->baseDemand, plans[s].price, plans[s].adSpend, ev, inventoryAvail[s]);
+            pool += max(0.0, mu[s]);
+            top = max(top, mu[s]);
+        }
+        pool = max(0.0, pool + this->sample(rng, sqrt((double)sellers)));
+        double w[8], sum = 0.0;
+        for (int s = 0; s < sellers; ++s) sum += (w[s] = simExp((mu[s] - top) / temperature));
+        for (int s = 0; s < sellers; ++s) demandOut[s] = (int)floor(pool * w[s] / sum + 0.5);
+    }
 };
 
-// ---------- Game Loop ----------
-int main() {
-    ios::sync_with_stdio(false);
-    cin.tie(nullptr);
+using Market = BasicMarket<RandomWalkDrift, LinearLogDemand, GaussianNoise, DefaultEvents>;
 
-    cout << "==============================\n";
-    cout << "  AI TYCOON – The Business Brain\n";
-    cout << "==============================\n\n";
-    cout << "Goal: Grow profits over 12 turns. Your AI advisor learns and suggests a plan each week.\n";
-    cout << "You sell a single product. Unit production cost = $8. Fixed weekly overhead = $1200.\n";
-    cout << "You begin with 40 units in inventory and $20,000 cash.\n\n";
+// ---------- Game Session ----------
+// One company, market and advisor plus the random stream that drives them.
+// The interactive loop and the headless runners both step through this, so
+// a seed plus a sequence of plans always reproduces the same game.
+struct SuggestRequest; // Batched Advice, below
+
+template<class M>
+struct BasicGameConfig {
+    M market;
+    Company company;
+    AdvisorConfig advisor;
+    int weeks = 12;
+};
 
+template<class M>
+struct BasicGame {
     Company co;
-    Market mk;
+    M mk;
     AIAdvisor ai;
-
-    int weeks = 12;
+    Rng rng;
     double baseProxy = 50.0; // what player/AI "believes" baseline demand might be (public noisy proxy)
+    int week = 0;
 
-    for (int week = 1; week <= weeks; ++week) {
-        cout << "\n==== Week " << week << " ====\n";
-        mk.drift();
-        MarketEvent ev = drawEvent(week);
-        cout << "Market event: " << ev.name << "\n";
+    explicit BasicGame(uint64_t seed = 12345, const BasicGameConfig<M>& cfg = BasicGameConfig<M>())
+        : co(cfg.company), mk(cfg.market), ai(cfg.advisor), rng(seed) {}
 
-        // AI suggestion
-        Plan plan = ai.suggest(co, baseProxy, ev.adShock, ev.priceShock);
-        cout << fixed << setprecision(2);
-        cout << "AI suggests -> Price: $" << plan.price
-             << " | Ad: $" << plan.adSpend
-             << " | Produce: " << plan.production << " units\n";
-        ai.printModel();
+    // Evolve the market and draw this week's event
+    MarketEvent beginWeek() {
+        ++week;
+        mk.drift(rng);
+        return mk.nextEvent(week, rng);
+    }
 
-        // Player choice
-        cout << "Accept AI plan? (y/n) ";
-        string yn; getline(cin, yn);
-        if (yn.size() == 0) { yn = "y"; }
-        Plan chosen = plan;
-        if (yn[0] == 'n' || yn[0] == 'N') {
-            cout << "Enter your Price [$9..$40]: ";
-            string s; getline(cin, s);
-            if (!s.empty()) chosen.price = clampv(stod(s), 9.0, 40.0);
+    Plan advise(const MarketEvent& ev) { return ai.suggest(co, baseProxy, ev.adShock, ev.priceShock); }
 
-            cout << "Enter your Ad Spend [$0..$10000]: ";
-            getline(cin, s);
-            if (!s.empty()) chosen.adSpend = clampv(stod(s), 0.0, 10000.0);
+    // The same question in a form SuggestBatch can answer
+    SuggestRequest adviceRequest(const MarketEvent& ev) const;
 
-            cout << "Enter your Production [0..200]: ";
-            getline(cin, s);
-            if (!s.empty()) chosen.production = (int)clampv(stoi(s), 0, 200);
-        }
+    // Play the chosen plan against the market and book the results
+    const Snapshot& resolveWeek(const Plan& chosen, const MarketEvent& ev) { return resolveWeek(chosen, ev, chosen.production); }
 
+    // Same, when only `arrived` units reach the shelves this week (production
+    // shipped through a supply network); the whole plan is still paid for
+    const Snapshot& resolveWeek(const Plan& chosen, const MarketEvent& ev, int arrived) {
         // Apply production (pay costs immediately)
-        co.inventory += chosen.production;
+        co.inventory += arrived;
 
         // Realize sales
-        int potential = mk.realizeDemand(chosen.price, chosen.adSpend, ev, co.inventory);
+        int potential = mk.realizeDemand(chosen.price, chosen.adSpend, ev, co.inventory, rng);
         int sold = min(potential, co.inventory);
         co.inventory -= sold;
 
@@ -289,22 +649,6520 @@ int main() {
         for (int i = start; i < (int)co.history.size(); ++i) avgSales += co.history[i].sold;
         avgSales /= (int)co.history.size() - start;
         // Blend with a little random noise to simulate imperfect info
-        normal_distribution<double> n(0.0, 3.0);
-        baseProxy = max(0.0, 0.70 * baseProxy + 0.30 * avgSales + n(rng));
+        baseProxy = max(0.0, 0.70 * baseProxy + 0.30 * avgSales + simNormal(rng, 0.0, 3.0));
 
-        // HUD
-        cout << fixed << setprecision(2);
-        cout << "\n— Results —\n";
-        cout << "Sold: " << sold << " units | Revenue: $" << revenue << "\n";
-        cout << "Costs: $" << cost << " | Profit: $" << profit << "\n";
-        cout << "End Inventory: " << co.inventory << " | Cash: $" << co.cash << "\n";
-        cout << "Market baseline (hidden true): " << mk.baseDemand
-             << " | Your inferred proxy: " << baseProxy << "\n";
+        return co.history.back();
+    }
 
-        if (co.cash < -5000.0) {
-            cout << "\nYou ran out of cash. Game over early.\n";
-            break;
+    bool bankrupt() const { return co.cash < -5000.0; }
+};
+
+using GameConfig = BasicGameConfig<Market>;
+using Game = BasicGame<Market>;
+
+struct GameResult {
+    uint64_t seed = 0;
+    int weeksPlayed = 0;
+    int unitsSold = 0;
+    double totalProfit = 0.0;
+    double finalCash = 0.0;
+    bool bankrupt = false;
+};
+
+// Headless game where the player always accepts the AI plan.
+// onWeek(const BasicGame<M>&, const Snapshot&) runs after every resolved week.
+template<class M, class OnWeek>
+GameResult playAutoGame(uint64_t seed, const BasicGameConfig<M>& cfg, OnWeek&& onWeek) {
+    BasicGame<M> game(seed, cfg);
+    GameResult res;
+    res.seed = seed;
+    for (int w = 1; w <= cfg.weeks; ++w) {
+        MarketEvent ev = game.beginWeek();
+        const Snapshot& snap = game.resolveWeek(game.advise(ev), ev);
+        onWeek(game, snap);
+        res.weeksPlayed = w;
+        res.unitsSold += snap.sold;
+        res.totalProfit += snap.profit;
+        if (game.bankrupt()) { res.bankrupt = true; break; }
+    }
+    res.finalCash = game.co.cash;
+    return res;
+}
+
+template<class M>
+GameResult playAutoGame(uint64_t seed, const BasicGameConfig<M>& cfg) {
+    return playAutoGame(seed, cfg, [](const BasicGame<M>&, const Snapshot&) {});
+}
+
+inline GameResult playAutoGame(uint64_t seed) { return playAutoGame(seed, GameConfig()); }
+
+// ---------- Batched Advice ----------
+// Many games stepping together produce one suggest() call per game per week,
+// but only five events exist. Pending calls are bucketed by the event's
+// (adShock, priceShock) so each bucket builds its price/ad feature tables
+// once, and calls with identical weights, inventory, costs and proxy are
+// searched once (every game's first week looks alike). The search keeps
+// suggestFor's loop order, tie-breaking and expression shapes, so plans match
+// the per-call path exactly.
+struct SuggestRequest {
+    AdvisorWeights w;
+    int inventory;
+    double unitCost, fixedCost, baseProxy;
+    double eventAdMult, eventPriceMult;
+};
+
+class SuggestBatch {
+public:
+    static constexpr int kPrices = 32, kAds = 17, kProds = 13;
+
+    void clear() { requests.clear(); }
+
+    size_t add(const SuggestRequest& r) {
+        requests.push_back(r);
+        return requests.size() - 1;
+    }
+
+    size_t size() const { return requests.size(); }
+    uint64_t totalRequests() const { return solvedRequests; }
+    uint64_t totalSearches() const { return solvedSearches; } // after coalescing
+
+    // plans()[i] answers the i-th add() since clear()
+    const vector<Plan>& solve() {
+        plans.resize(requests.size());
+        buckets.clear();
+        for (uint32_t i = 0; i < requests.size(); ++i) {
+            const SuggestRequest& r = requests[i];
+            Bucket* b = nullptr;
+            for (Bucket& x : buckets)
+                if (x.adMult == r.eventAdMult && x.priceMult == r.eventPriceMult) { b = &x; break; }
+            if (!b) {
+                buckets.emplace_back();
+                b = &buckets.back();
+                b->build(r.eventAdMult, r.eventPriceMult);
+            }
+            b->members.push_back(i);
+        }
+
+        solvedRequests += requests.size();
+        for (Bucket& b : buckets) {
+            auto key = [&](uint32_t i) {
+                const SuggestRequest& r = requests[i];
+                return make_tuple(r.w.w0, r.w.wP, r.w.wA, r.w.wB, r.w.wI, r.inventory, r.unitCost, r.fixedCost, r.baseProxy);
+            };
+            sort(b.members.begin(), b.members.end(), [&](uint32_t x, uint32_t y) { return key(x) < key(y); });
+            for (size_t j = 0; j < b.members.size(); ++j) {
+                uint32_t i = b.members[j];
+                if (j > 0 && key(b.members[j - 1]) == key(i)) { plans[i] = plans[b.members[j - 1]]; continue; }
+                plans[i] = search(b, requests[i]);
+                ++solvedSearches;
+            }
+        }
+        return plans;
+    }
+
+private:
+    struct Bucket {
+        double adMult, priceMult;
+        double price[kPrices], xP[kPrices], ad[kAds], xA[kAds];
+        vector<uint32_t> members;
+
+        void build(double adShock, double priceShock) {
+            adMult = adShock;
+            priceMult = priceShock;
+            int i = 0;
+            for (double p = 9.0; p <= 40.0; p += 1.0, ++i) { price[i] = p; xP[i] = - p * (1.0 + priceShock); }
+            i = 0;
+            for (double a = 0.0; a <= 8000.0; a += 500.0, ++i) { ad[i] = a; xA[i] = simLog1p(a) * (1.0 + adShock); }
+        }
+    };
+
+    static Plan search(const Bucket& b, const SuggestRequest& r) {
+        double xI[kProds], cost[kAds][kProds];
+        for (int j = 0; j < kProds; ++j) xI[j] = (double)(r.inventory + 10 * j);
+        for (int a = 0; a < kAds; ++a)
+            for (int j = 0; j < kProds; ++j) {
+                int prod = 10 * j;
+                cost[a][j] = prod * r.unitCost + b.ad[a] + r.fixedCost;
+            }
+
+        double bestProfit = -1e18;
+        Plan best{20, 1000, 50};
+        for (int i = 0; i < kPrices; ++i) {
+            double s1 = r.w.w0 + r.w.wP * b.xP[i];
+            for (int a = 0; a < kAds; ++a) {
+                double s2 = s1 + r.w.wA * b.xA[a];
+                double s3 = s2 + r.w.wB * r.baseProxy;
+                for (int j = 0; j < kProds; ++j) {
+                    double demandHat = max(0.0, s3 + r.w.wI * xI[j]);
+                    int canSell = min((int)round(demandHat), r.inventory + 10 * j);
+                    double profit = canSell * b.price[i] - cost[a][j];
+                    if (profit > bestProfit) {
+                        bestProfit = profit;
+                        best = {b.price[i], b.ad[a], 10 * j};
+                    }
+                }
+            }
+        }
+        return best;
+    }
+
+    vector<SuggestRequest> requests;
+    vector<Plan> plans;
+    vector<Bucket> buckets;
+    uint64_t solvedRequests = 0, solvedSearches = 0;
+};
+
+template<class M>
+SuggestRequest BasicGame<M>::adviceRequest(const MarketEvent& ev) const {
+    return {ai.weights(), co.inventory, co.unitCost, co.fixedCost, baseProxy, ev.adShock, ev.priceShock};
+}
+
+// Plays games [firstSeed, firstSeed + n) week by week in lockstep, answering
+// each week's advice for all of them with one SuggestBatch. Results match
+// playAutoGame seed for seed. onWeek(size_t i, const BasicGame<M>&, const Snapshot&)
+// runs after game i resolves a week.
+template<class M, class OnWeek>
+void playAutoGamesBatched(uint64_t firstSeed, size_t n, const BasicGameConfig<M>& cfg,
+                          SuggestBatch& batch, GameResult* out, OnWeek&& onWeek)
+{
+    vector<BasicGame<M>> games;
+    games.reserve(n);
+    vector<MarketEvent> events(n);
+    vector<uint32_t> live(n);
+    for (size_t i = 0; i < n; ++i) {
+        games.emplace_back(firstSeed + i, cfg);
+        out[i] = GameResult();
+        out[i].seed = firstSeed + i;
+        live[i] = (uint32_t)i;
+    }
+    for (int w = 1; w <= cfg.weeks && !live.empty(); ++w) {
+        batch.clear();
+        for (uint32_t i : live) {
+            events[i] = games[i].beginWeek();
+            batch.add(games[i].adviceRequest(events[i]));
+        }
+        const vector<Plan>& plans = batch.solve();
+        size_t kept = 0;
+        for (size_t j = 0; j < live.size(); ++j) {
+            uint32_t i = live[j];
+            const Snapshot& snap = games[i].resolveWeek(plans[j], events[i]);
+            onWeek((size_t)i, games[i], snap);
+            out[i].weeksPlayed = w;
+            out[i].unitsSold += snap.sold;
+            out[i].totalProfit += snap.profit;
+            if (games[i].bankrupt()) out[i].bankrupt = true;
+            else live[kept++] = i;
+        }
+        live.resize(kept);
+    }
+    for (size_t i = 0; i < n; ++i) out[i].finalCash = games[i].co.cash;
+}
+
+template<class M>
+void playAutoGamesBatched(uint64_t firstSeed, size_t n, const BasicGameConfig<M>& cfg,
+                          SuggestBatch& batch, GameResult* out)
+{
+    playAutoGamesBatched(firstSeed, n, cfg, batch, out, [](size_t, const BasicGame<M>&, const Snapshot&) {});
+}
+
+// Single-threaded: per-call advice against lockstep batches of `lockstep` games
+int runAdviceBench(int games, int lockstep) {
+    GameConfig cfg;
+    vector<GameResult> perCall(games), batched(games);
+    auto t0 = chrono::steady_clock::now();
+    for (int i = 0; i < games; ++i) perCall[i] = playAutoGame(1 + i, cfg);
+    auto t1 = chrono::steady_clock::now();
+    SuggestBatch batch;
+    for (int b = 0; b < games; b += lockstep)
+        playAutoGamesBatched(1 + b, min(lockstep, games - b), cfg, batch, batched.data() + b);
+    auto t2 = chrono::steady_clock::now();
+
+    int mismatches = 0;
+    for (int i = 0; i < games; ++i)
+        if (perCall[i].totalProfit != batched[i].totalProfit || perCall[i].weeksPlayed != batched[i].weeksPlayed
+            || perCall[i].finalCash != batched[i].finalCash) ++mismatches;
+    double a = chrono::duration<double>(t1 - t0).count(), b = chrono::duration<double>(t2 - t1).count();
+    cout << fixed << setprecision(1);
+    cout << "Advice for " << games << " games (" << lockstep << " in lockstep)\n";
+    cout << "  per call : " << a / games * 1e6 << " us/game\n";
+    cout << "  batched  : " << b / games * 1e6 << " us/game (" << setprecision(2) << a / b << "x), "
+         << batch.totalSearches() << " searches for " << batch.totalRequests() << " calls\n";
+    cout << "  result mismatches: " << mismatches << "\n";
+    return mismatches == 0 ? 0 : 1;
+}
+
+// ---------- Worker Pool ----------
+// Persistent threads for fork-join loops. parallelFor splits [0, n) into
+// grain-sized chunks; the calling thread takes chunks too and returns once
+// every chunk has run, so small loops stay cheap on a single core.
+class WorkerPool {
+public:
+    explicit WorkerPool(unsigned threads = max(1u, thread::hardware_concurrency())) {
+        for (unsigned t = 1; t < threads; ++t) workers.emplace_back([this] { workerLoop(); });
+    }
+
+    ~WorkerPool() {
+        { lock_guard<mutex> lk(m); stopping = true; }
+        cv.notify_all();
+        for (auto& w : workers) w.join();
+    }
+
+    unsigned size() const { return (unsigned)workers.size() + 1; }
+
+    void parallelFor(size_t n, size_t grain, const function<void(size_t, size_t)>& fn) {
+        if (n == 0) return;
+        grain = max<size_t>(1, grain);
+        if (workers.empty() || n <= grain) { fn(0, n); return; }
+
+        auto job = make_shared<Job>();
+        job->fn = &fn;
+        job->n = n;
+        job->grain = grain;
+        job->chunks = (n + grain - 1) / grain;
+        {
+            lock_guard<mutex> lk(m);
+            current = job;
+            ++generation;
+        }
+        cv.notify_all();
+        runChunks(*job);
+        while (job->done.load(memory_order_acquire) < job->chunks) this_thread::yield();
+    }
+
+private:
+    struct Job {
+        const function<void(size_t, size_t)>* fn = nullptr;
+        size_t n = 0, grain = 1, chunks = 0;
+        atomic<size_t> next{0};
+        atomic<size_t> done{0};
+    };
+
+    vector<thread> workers;
+    mutex m;
+    condition_variable cv;
+    shared_ptr<Job> current;
+    uint64_t generation = 0;
+    bool stopping = false;
+
+    static void runChunks(Job& job) {
+        for (;;) {
+            size_t c = job.next.fetch_add(1, memory_order_relaxed);
+            if (c >= job.chunks) return;
+            size_t begin = c * job.grain;
+            (*job.fn)(begin, min(job.n, begin + job.grain));
+            job.done.fetch_add(1, memory_order_release);
+        }
+    }
+
+    void workerLoop() {
+        uint64_t seen = 0;
+        for (;;) {
+            shared_ptr<Job> job;
+            {
+                unique_lock<mutex> lk(m);
+                cv.wait(lk, [&] { return stopping || generation != seen; });
+                if (stopping) return;
+                seen = generation;
+                job = current;
+            }
+            runChunks(*job);
+        }
+    }
+};
+
+// ---------- Supply Network ----------
+// Multi-echelon distribution: plants -> distribution centers -> stores.
+// Every non-plant node has exactly one supplier, so the network is a forest
+// and a node's inbound shipments are written only by its parent. Nodes are
+// stored level by level (SoA); each level is processed in parallel, orders
+// bottom-up and shipments top-down.
+enum class NodeKind : uint8_t { Plant, DistributionCenter, Store };
+
+struct SupplyNodeSpec {
+    NodeKind kind;
+    int parent;        // supplier index in the spec list, -1 for plants
+    int capacity;      // units a plant can make / a node can ship per week
+    int leadTime;      // weeks for a shipment from the parent to arrive (at least 1)
+    int targetStock;   // order-up-to level (inventory + pipeline)
+    int inventory;     // starting inventory
+};
+
+struct SupplyWeekStats {
+    long long demand = 0;
+    long long sold = 0;
+    long long produced = 0;
+    long long shipped = 0;
+};
+
+class SupplyNetwork {
+public:
+    // With plantsMakeToOrder false the plants make nothing themselves; stock
+    // enters through addPlantStock (a company's own production plan).
+    explicit SupplyNetwork(const vector<SupplyNodeSpec>& specs, bool plantsMakeToOrder = true)
+        : makeToOrder(plantsMakeToOrder) { build(specs); }
+
+    int nodeCount() const { return (int)kind.size(); }
+    int levelCount() const { return (int)levelStart.size() - 1; }
+    // Position of a spec index in the level-ordered layout (demand arrays use it)
+    int slotOf(int specIndex) const { return slot[specIndex]; }
+    int inventoryAt(int specIndex) const { return inventory[slot[specIndex]]; }
+
+    // Finished units land at the plants, split evenly, ready to ship this week
+    void addPlantStock(int units) {
+        const int plants = levelCount() > 0 ? levelStart[1] : 0;
+        if (plants == 0) throw runtime_error("supply network has no plants");
+        for (int i = 0; i < plants; ++i) inventory[i] += units / plants + (i < units % plants ? 1 : 0);
+    }
+
+    // Empties every store and returns what they held
+    int takeStoreStock() {
+        long long sum = 0;
+        for (int i = 0; i < nodeCount(); ++i)
+            if (kind[i] == NodeKind::Store) { sum += inventory[i]; inventory[i] = 0; }
+        return (int)sum;
+    }
+
+    // Advance one week. storeDemand is indexed by spec index; non-store entries are ignored.
+    SupplyWeekStats step(const vector<int>& storeDemand, WorkerPool* pool = nullptr) {
+        const size_t L = pipeLen;
+        const size_t cur = week % pipeLen;
+
+        auto forLevel = [&](int lvl, const function<void(size_t, size_t)>& body) {
+            size_t b = levelStart[lvl], e = levelStart[lvl + 1];
+            auto shifted = [&](size_t lo, size_t hi) { body(b + lo, b + hi); };
+            if (pool) pool->parallelFor(e - b, kLevelGrain, shifted);
+            else shifted(0, e - b);
+        };
+
+        // 1) Receive arrivals and serve store demand
+        atomic<long long> demandAcc{0}, soldAcc{0};
+        for (int lvl = 0; lvl < levelCount(); ++lvl) {
+            forLevel(lvl, [&](size_t b, size_t e) {
+                long long d = 0, s = 0;
+                for (size_t i = b; i < e; ++i) {
+                    int& due = pipeline[i * L + cur];
+                    inventory[i] += due;
+                    inTransit[i] -= due;
+                    due = 0;
+                    if (kind[i] != NodeKind::Store) continue;
+                    int want = storeDemand[spec[i]];
+                    int got = min(want, inventory[i]);
+                    inventory[i] -= got;
+                    d += want;
+                    s += got;
+                }
+                demandAcc.fetch_add(d, memory_order_relaxed);
+                soldAcc.fetch_add(s, memory_order_relaxed);
+            });
+        }
+        SupplyWeekStats stats;
+        stats.demand = demandAcc.load();
+        stats.sold = soldAcc.load();
+
+        // 2) Orders flow upstream: each node asks its supplier for its own
+        //    shortfall plus what its children asked for.
+        for (int lvl = levelCount() - 1; lvl >= 0; --lvl) {
+            forLevel(lvl, [&](size_t b, size_t e) {
+                for (size_t i = b; i < e; ++i) {
+                    long long req = 0;
+                    for (int c = childBegin[i]; c < childBegin[i + 1]; ++c) req += order[c];
+                    childRequest[i] = req;
+                    long long gap = (long long)targetStock[i] - inventory[i] - inTransit[i];
+                    order[i] = (int)min<long long>(INT32_MAX, max(0LL, gap) + (kind[i] == NodeKind::Plant ? 0 : req));
+                }
+            });
+        }
+
+        // 3) Plants produce, then shipments flow downstream within capacity,
+        //    split across children in proportion to their orders.
+        atomic<long long> prodAcc{0}, shipAcc{0};
+        for (int lvl = 0; lvl < levelCount(); ++lvl) {
+            forLevel(lvl, [&](size_t b, size_t e) {
+                long long p = 0, sh = 0;
+                for (size_t i = b; i < e; ++i) {
+                    if (kind[i] == NodeKind::Plant && makeToOrder) {
+                        long long want = max(0LL, (long long)targetStock[i] - inventory[i]) + childRequest[i];
+                        int make = (int)min<long long>(capacity[i], want);
+                        inventory[i] += make;
+                        p += make;
+                    }
+                    long long req = childRequest[i];
+                    if (req <= 0) continue;
+                    int budget = (int)min<long long>({(long long)inventory[i], (long long)capacity[i], req});
+                    int left = budget;
+                    for (int c = childBegin[i]; c < childBegin[i + 1] && left > 0; ++c) {
+                        int q = (int)min<long long>(left, (long long)budget * order[c] / req);
+                        if (c + 1 == childBegin[i + 1]) q = min(left, order[c]);
+                        if (q <= 0) continue;
+                        pipeline[c * L + (week + leadTime[c]) % pipeLen] += q;
+                        inTransit[c] += q;
+                        left -= q;
+                    }
+                    inventory[i] -= budget - left;
+                    sh += budget - left;
+                }
+                prodAcc.fetch_add(p, memory_order_relaxed);
+                shipAcc.fetch_add(sh, memory_order_relaxed);
+            });
+        }
+        stats.produced = prodAcc.load();
+        stats.shipped = shipAcc.load();
+        ++week;
+        return stats;
+    }
+
+private:
+    static constexpr size_t kLevelGrain = 2048; // nodes per task; smaller levels run inline
+
+    bool makeToOrder = true;
+    int week = 0;
+    int pipeLen = 1;
+    vector<NodeKind> kind;
+    vector<int> spec, slot;               // level-order slot <-> spec index
+    vector<int> capacity, leadTime, targetStock, inventory, inTransit, order;
+    vector<long long> childRequest;
+    vector<int> childBegin;               // children of slot i are [childBegin[i], childBegin[i+1])
+    vector<int> levelStart;               // slots of level l are [levelStart[l], levelStart[l+1])
+    vector<int> pipeline;                 // pipeLen arrival buckets per node
+
+    void build(const vector<SupplyNodeSpec>& specs) {
+        const int n = (int)specs.size();
+        vector<vector<int>> kids(n);
+        vector<int> roots;
+        for (int i = 0; i < n; ++i) {
+            if (specs[i].parent < 0) roots.push_back(i);
+            else kids[specs[i].parent].push_back(i);
+        }
+
+        // Breadth-first from the plants gives a topological, level-contiguous
+        // order in which each node's children are adjacent.
+        spec = roots;
+        levelStart = {0};
+        size_t head = 0;
+        while (head < spec.size()) {
+            size_t levelEnd = spec.size();
+            for (; head < levelEnd; ++head)
+                for (int c : kids[spec[head]]) spec.push_back(c);
+            levelStart.push_back((int)levelEnd);
+        }
+        if ((int)spec.size() != n) throw runtime_error("supply network has a cycle or a dangling supplier");
+
+        slot.assign(n, 0);
+        for (int i = 0; i < n; ++i) slot[spec[i]] = i;
+        kind.resize(n);
+        capacity.resize(n); leadTime.resize(n); targetStock.resize(n);
+        inventory.resize(n); inTransit.assign(n, 0); order.assign(n, 0);
+        childRequest.assign(n, 0);
+        childBegin.assign(n + 1, 0);
+        int maxLead = 0;
+        for (int i = 0; i < n; ++i) {
+            const SupplyNodeSpec& s = specs[spec[i]];
+            kind[i] = s.kind;
+            capacity[i] = max(0, s.capacity);
+            // shipments leave after this week's arrivals were received, so the
+            // earliest they can land is next week
+            leadTime[i] = max(1, s.leadTime);
+            targetStock[i] = max(0, s.targetStock);
+            inventory[i] = max(0, s.inventory);
+            maxLead = max(maxLead, leadTime[i]);
+        }
+        // children were appended in parent order, so they are contiguous
+        int next = levelStart.size() > 1 ? levelStart[1] : n;
+        for (int i = 0; i < n; ++i) {
+            childBegin[i] = next;
+            next += (int)kids[spec[i]].size();
         }
+        childBegin[n] = next;
+        pipeLen = maxLead + 1;
+        pipeline.assign((size_t)n * pipeLen, 0);
+    }
+};
+
+// Synthetic plant/DC/store network used by the benchmark
+vector<SupplyNodeSpec> makeSupplyNetwork(int nodes, std::mt19937_64& g) {
+    int plants = max(1, nodes / 100);
+    int dcs = max(1, nodes / 10);
+    int stores = max(1, nodes - plants - dcs);
+    vector<SupplyNodeSpec> specs;
+    uniform_int_distribution<int> lead(1, 3);
+    for (int p = 0; p < plants; ++p)
+        specs.push_back({NodeKind::Plant, -1, 6000, 0, 4000, 2000});
+    for (int d = 0; d < dcs; ++d)
+        specs.push_back({NodeKind::DistributionCenter, d % plants, 2000, lead(g), 1200, 600});
+    for (int s = 0; s < stores; ++s)
+        specs.push_back({NodeKind::Store, plants + s % dcs, 200, lead(g), 150, 60});
+    return specs;
+}
+
+int runSupplyBench(int nodes, int weeks) {
+    std::mt19937_64 g(2024);
+    vector<SupplyNodeSpec> specs = makeSupplyNetwork(nodes, g);
+    SupplyNetwork net(specs);
+    WorkerPool pool;
+    vector<int> demand(specs.size(), 0);
+    normal_distribution<double> noise(0.0, 6.0);
+
+    double totalUs = 0.0;
+    SupplyWeekStats sum;
+    for (int w = 0; w < weeks; ++w) {
+        for (size_t i = 0; i < specs.size(); ++i)
+            demand[i] = specs[i].kind == NodeKind::Store ? max(0, (int)lround(40.0 + noise(g))) : 0;
+        auto t0 = chrono::steady_clock::now();
+        SupplyWeekStats st = net.step(demand, &pool);
+        totalUs += chrono::duration<double, micro>(chrono::steady_clock::now() - t0).count();
+        sum.demand += st.demand; sum.sold += st.sold;
+        sum.produced += st.produced; sum.shipped += st.shipped;
+    }
+    cout << fixed << setprecision(2);
+    cout << "Supply network: " << net.nodeCount() << " nodes, " << net.levelCount()
+         << " levels, " << pool.size() << " threads\n";
+    cout << "Avg step: " << totalUs / max(1, weeks) << " us/week over " << weeks << " weeks\n";
+    cout << "Fill rate: " << (sum.demand ? 100.0 * sum.sold / sum.demand : 100.0) << "% | Produced: "
+         << sum.produced << " | Shipped: " << sum.shipped << "\n";
+    return 0;
+}
+
+// Opt-in supply path for a game: the plan's production is made at the
+// plants of `specs` (which then only ship) and is sellable once it reaches a
+// store, so lead times delay it. Otherwise plays like playAutoGame.
+template<class M>
+GameResult playSuppliedGame(uint64_t seed, const BasicGameConfig<M>& cfg, const vector<SupplyNodeSpec>& specs) {
+    BasicGame<M> game(seed, cfg);
+    SupplyNetwork net(specs, false);
+    const vector<int> noDemand(specs.size(), 0); // stores only pass stock on; the game sells it
+    GameResult res;
+    res.seed = seed;
+    for (int w = 1; w <= cfg.weeks; ++w) {
+        MarketEvent ev = game.beginWeek();
+        Plan plan = game.advise(ev);
+        net.addPlantStock(plan.production);
+        net.step(noDemand);
+        const Snapshot& snap = game.resolveWeek(plan, ev, net.takeStoreStock());
+        res.weeksPlayed = w;
+        res.unitsSold += snap.sold;
+        res.totalProfit += snap.profit;
+        if (game.bankrupt()) { res.bankrupt = true; break; }
+    }
+    res.finalCash = game.co.cash;
+    return res;
+}
+
+// The same games with production on the shelf at once and shipped through
+// plant -> DC -> store networks of growing lead time
+int runSupplyGame(int games) {
+    GameConfig cfg;
+    auto summarize = [&](const char* label, const function<GameResult(uint64_t)>& play) {
+        double profit = 0.0;
+        int bankrupt = 0;
+        for (int g = 0; g < games; ++g) {
+            GameResult r = play(1 + g);
+            profit += r.totalProfit;
+            bankrupt += r.bankrupt;
+        }
+        cout << "  " << left << setw(22) << label << right << " mean profit $" << setw(10) << profit / games
+             << ", bankrupt " << setw(5) << 100.0 * bankrupt / games << "%\n";
+    };
+    cout << fixed << setprecision(2);
+    cout << "Supplied games (" << games << " seeds, advisor unaware of stock in transit):\n";
+    summarize("direct", [&](uint64_t seed) { return playAutoGame(seed, cfg); });
+    for (int lead = 1; lead <= 3; ++lead) {
+        vector<SupplyNodeSpec> specs{{NodeKind::Plant, -1, 400, 0, 0, 0}};
+        for (int d = 0; d < 2; ++d) {
+            int dc = (int)specs.size();
+            specs.push_back({NodeKind::DistributionCenter, 0, 200, lead, 60, 0});
+            for (int st = 0; st < 3; ++st) specs.push_back({NodeKind::Store, dc, 100, lead, 20, 0});
+        }
+        string label = "lead " + to_string(lead) + "+" + to_string(lead) + " weeks";
+        summarize(label.c_str(), [&](uint64_t seed) { return playSuppliedGame(seed, cfg, specs); });
+    }
+    return 0;
+}
+
+// ---------- Trace Sink ----------
+// Binary per-week trace for Monte Carlo runs. Records are packed into
+// fixed-size, page-aligned blocks and written with direct I/O so traces do
+// not churn the page cache. On Linux the blocks go through io_uring with many
+// writes in flight; elsewhere (or if the ring cannot be set up) a background
+// thread issues plain pwrite calls. Simulation threads only ever copy into
+// their lane's block and hand full blocks over.
+struct TraceRecord {
+    uint64_t gameId;
+    int32_t week;
+    int32_t production;
+    int32_t sold;
+    int32_t inventoryEnd;
+    double baseDemand;
+    double eventBoost;
+    double price;
+    double adSpend;
+    double revenue;
+    double cost;
+    double profit;
+    double cash;       // end-of-week cash
+    uint64_t reserved;
+};
+static_assert(sizeof(TraceRecord) == 96, "trace record layout is part of the file format");
+
+struct TraceBlockHeader {
+    char magic[4];      // "ATRC"
+    uint32_t version;
+    uint32_t recordSize;
+    uint32_t count;     // records used in this block
+    uint64_t blockIndex;
+    uint8_t pad[40];
+};
+static_assert(sizeof(TraceBlockHeader) == 64, "trace block header layout is part of the file format");
+
+inline TraceRecord makeTraceRecord(uint64_t gameId, const Snapshot& s, double cash) {
+    return {gameId, s.week, s.production, s.sold, s.inventoryEnd,
+            s.baseDemand, s.eventBoost, s.price, s.adSpend,
+            s.revenue, s.cost, s.profit, cash, 0};
+}
+
+#if AITYCOON_HAVE_IO_URING
+// Just enough of io_uring for queued writes, driven by raw syscalls (no liburing)
+class UringQueue {
+public:
+    UringQueue() = default;
+    UringQueue(const UringQueue&) = delete;
+    UringQueue& operator=(const UringQueue&) = delete;
+    ~UringQueue() { reset(); }
+
+    bool init(unsigned entries) {
+        io_uring_params p{};
+        ringFd = (int)syscall(__NR_io_uring_setup, entries, &p);
+        if (ringFd < 0) return false;
+        sqBytes = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+        cqBytes = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+        bool single = p.features & IORING_FEAT_SINGLE_MMAP;
+        if (single) sqBytes = cqBytes = max(sqBytes, cqBytes);
+        sqRing = mmap(nullptr, sqBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQ_RING);
+        if (sqRing == MAP_FAILED) { sqRing = nullptr; reset(); return false; }
+        cqRing = single ? sqRing
+                        : mmap(nullptr, cqBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_CQ_RING);
+        if (cqRing == MAP_FAILED) { cqRing = nullptr; reset(); return false; }
+        sqeBytes = p.sq_entries * sizeof(io_uring_sqe);
+        void* s = mmap(nullptr, sqeBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQES);
+        if (s == MAP_FAILED) { reset(); return false; }
+        sqes = (io_uring_sqe*)s;
+
+        char* sq = (char*)sqRing;
+        sqHead = (unsigned*)(sq + p.sq_off.head);
+        sqTail = (unsigned*)(sq + p.sq_off.tail);
+        sqMask = *(unsigned*)(sq + p.sq_off.ring_mask);
+        sqEntries = p.sq_entries;
+        sqArray = (unsigned*)(sq + p.sq_off.array);
+        char* cq = (char*)cqRing;
+        cqHead = (unsigned*)(cq + p.cq_off.head);
+        cqTail = (unsigned*)(cq + p.cq_off.tail);
+        cqMask = *(unsigned*)(cq + p.cq_off.ring_mask);
+        cqes = (io_uring_cqe*)(cq + p.cq_off.cqes);
+        return true;
+    }
+
+    // Queue a write; false if the submission ring is full
+    bool pushWrite(int fd, const void* buf, unsigned len, uint64_t off, uint64_t userData) {
+        unsigned tail = *sqTail;
+        if (tail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE) >= sqEntries) return false;
+        unsigned idx = tail & sqMask;
+        io_uring_sqe& e = sqes[idx];
+        memset(&e, 0, sizeof(e));
+        e.opcode = IORING_OP_WRITE;
+        e.fd = fd;
+        e.addr = (uint64_t)(uintptr_t)buf;
+        e.len = len;
+        e.off = off;
+        e.user_data = userData;
+        sqArray[idx] = idx;
+        __atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+        ++unsubmitted;
+        return true;
+    }
+
+    // Block until at least n completions exist, submitting nothing; safe to
+    // call without the lock that guards the rings
+    int waitCompletions(unsigned n) const {
+        return (int)syscall(__NR_io_uring_enter, ringFd, 0, n, IORING_ENTER_GETEVENTS, nullptr, 0);
+    }
+
+    // Submit queued entries, optionally blocking until minComplete completions exist
+    int enter(unsigned minComplete) {
+        unsigned flags = minComplete ? IORING_ENTER_GETEVENTS : 0;
+        int r = (int)syscall(__NR_io_uring_enter, ringFd, unsubmitted, minComplete, flags, nullptr, 0);
+        if (r >= 0) unsubmitted -= min<unsigned>(unsubmitted, (unsigned)r);
+        return r;
+    }
+
+    bool popCompletion(uint64_t& userData, int& res) {
+        unsigned head = *cqHead;
+        if (head == __atomic_load_n(cqTail, __ATOMIC_ACQUIRE)) return false;
+        const io_uring_cqe& c = cqes[head & cqMask];
+        userData = c.user_data;
+        res = c.res;
+        __atomic_store_n(cqHead, head + 1, __ATOMIC_RELEASE);
+        return true;
+    }
+
+private:
+    int ringFd = -1;
+    void* sqRing = nullptr;
+    void* cqRing = nullptr;
+    size_t sqBytes = 0, cqBytes = 0, sqeBytes = 0;
+    io_uring_sqe* sqes = nullptr;
+    unsigned *sqHead = nullptr, *sqTail = nullptr, *sqArray = nullptr;
+    unsigned sqMask = 0, sqEntries = 0;
+    unsigned *cqHead = nullptr, *cqTail = nullptr;
+    unsigned cqMask = 0;
+    io_uring_cqe* cqes = nullptr;
+    unsigned unsubmitted = 0;
+
+    void reset() {
+        if (sqes) munmap(sqes, sqeBytes);
+        if (cqRing && cqRing != sqRing) munmap(cqRing, cqBytes);
+        if (sqRing) munmap(sqRing, sqBytes);
+        if (ringFd >= 0) ::close(ringFd);
+        sqes = nullptr; sqRing = cqRing = nullptr; ringFd = -1;
+    }
+};
+#endif
+
+class TraceSink {
+public:
+    // A producer's partially filled block; take one per worker chunk
+    struct Lane {
+        char* block = nullptr;
+        uint32_t count = 0;
+    };
+
+    TraceSink(const string& path, size_t blockBytes = 1 << 20, unsigned inFlight = 16)
+        : blockBytes(max<size_t>(kAlign, (blockBytes + kAlign - 1) / kAlign * kAlign)),
+          perBlock((uint32_t)((this->blockBytes - sizeof(TraceBlockHeader)) / sizeof(TraceRecord))),
+          depth(max(1u, inFlight))
+    {
+        int flags = O_WRONLY | O_CREAT | O_TRUNC;
+#ifdef O_DIRECT
+        fd = ::open(path.c_str(), flags | O_DIRECT, 0644);
+        if (fd >= 0) direct = true;
+#endif
+        if (fd < 0) fd = ::open(path.c_str(), flags, 0644);
+        if (fd < 0) throw runtime_error("cannot open trace file " + path);
+#ifdef F_NOCACHE
+        direct = fcntl(fd, F_NOCACHE, 1) == 0;
+#endif
+#if AITYCOON_HAVE_IO_URING
+        useRing = ring.init(depth);
+#endif
+        if (!useRing) writer = thread([this] { pwriteLoop(); });
+    }
+
+    // Never throws; call close() to find out whether every block was written
+    ~TraceSink() { shutdown(); }
+
+    Lane* acquireLane() {
+        lock_guard<mutex> lk(m);
+        if (idleLanes.empty()) {
+            lanes.emplace_back(new Lane);
+            return lanes.back().get();
+        }
+        Lane* l = idleLanes.back();
+        idleLanes.pop_back();
+        return l;
+    }
+
+    void releaseLane(Lane* lane) {
+        lock_guard<mutex> lk(m);
+        idleLanes.push_back(lane);
+    }
+
+    void append(Lane& lane, const TraceRecord& r) {
+        if (!lane.block) lane.block = takeBuffer();
+        memcpy(lane.block + sizeof(TraceBlockHeader) + (size_t)lane.count * sizeof(TraceRecord), &r, sizeof(r));
+        if (++lane.count == perBlock) submit(lane);
+    }
+
+    // Flush partial blocks, wait for every write and close the file. Write
+    // errors are latched rather than thrown on producer threads (they run
+    // inside parallelFor); the first one is thrown here.
+    void close() {
+        shutdown();
+        if (!writeError.empty()) throw runtime_error(writeError);
+    }
+
+    const char* backend() const { return useRing ? (direct ? "io_uring+direct" : "io_uring") : (direct ? "pwrite+direct" : "pwrite"); }
+    uint64_t bytesWritten() const { return nextBlock * blockBytes; }
+    uint32_t recordsPerBlock() const { return perBlock; }
+
+private:
+    static constexpr size_t kAlign = 4096;
+
+    const size_t blockBytes;
+    const uint32_t perBlock;
+    const unsigned depth;
+    int fd = -1;
+    bool direct = false;
+    bool useRing = false;
+#if AITYCOON_HAVE_IO_URING
+    UringQueue ring;
+#endif
+
+    mutex m;
+    condition_variable cv;
+    vector<unique_ptr<Lane>> lanes;
+    vector<Lane*> idleLanes;
+    vector<char*> buffers, freeBuffers;
+    vector<pair<char*, uint64_t>> queued; // pwrite backend: block + file offset
+    unsigned outstanding = 0;
+    uint64_t nextBlock = 0;
+    bool stopping = false;
+    string writeError;       // first write failure, thrown by close()
+    bool ringBroken = false; // io_uring_enter failed; completions can no longer be reaped
+    uint64_t retired = 0;    // writes completed so far
+    thread writer;
+
+    void shutdown() {
+        if (fd < 0) return;
+        for (auto& l : lanes)
+            if (l->count) submit(*l);
+        {
+            unique_lock<mutex> lk(m);
+            while (outstanding > 0 && !ringBroken) waitForCompletion(lk);
+            stopping = true;
+        }
+        cv.notify_all();
+        if (writer.joinable()) writer.join();
+        // a broken ring may still read its in-flight blocks, so those are leaked
+        if (!ringBroken) {
+            for (char* b : buffers) free(b);
+        }
+        buffers.clear();
+        ::close(fd);
+        fd = -1;
+    }
+
+    // Caller holds m
+    void fail(const string& what) {
+        if (writeError.empty()) writeError = what;
+    }
+
+    char* takeBuffer() {
+        unique_lock<mutex> lk(m);
+        for (;;) {
+            if (!freeBuffers.empty()) {
+                char* b = freeBuffers.back();
+                freeBuffers.pop_back();
+                return b;
+            }
+            if (buffers.size() < depth + lanes.size()) {
+                void* p = aligned_alloc(kAlign, blockBytes);
+                if (!p) throw bad_alloc();
+                buffers.push_back((char*)p);
+                return (char*)p;
+            }
+            waitForCompletion(lk);
+        }
+    }
+
+    void submit(Lane& lane) {
+        TraceBlockHeader h{};
+        memcpy(h.magic, "ATRC", 4);
+        h.version = 1;
+        h.recordSize = sizeof(TraceRecord);
+        h.count = lane.count;
+        char* block = lane.block;
+        // zero the unused tail so short blocks never leak stale records
+        memset(block + sizeof(h) + (size_t)lane.count * sizeof(TraceRecord), 0,
+               blockBytes - sizeof(h) - (size_t)lane.count * sizeof(TraceRecord));
+        lane.block = nullptr;
+        lane.count = 0;
+
+        unique_lock<mutex> lk(m);
+        while (outstanding >= depth && !ringBroken) waitForCompletion(lk);
+        // once a write has failed the file is incomplete anyway; recycle the block
+        if (!writeError.empty()) {
+            freeBuffers.push_back(block);
+            return;
+        }
+        h.blockIndex = nextBlock++;
+        memcpy(block, &h, sizeof(h));
+        uint64_t off = h.blockIndex * blockBytes;
+        ++outstanding;
+#if AITYCOON_HAVE_IO_URING
+        if (useRing) {
+            while (!ring.pushWrite(fd, block, (unsigned)blockBytes, off, (uint64_t)(uintptr_t)block)) {
+                waitForCompletion(lk);
+                if (ringBroken) {
+                    --outstanding;
+                    freeBuffers.push_back(block);
+                    return;
+                }
+            }
+            if (ring.enter(0) < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY)
+                fail(string("io_uring_enter failed: ") + strerror(errno));
+            return;
+        }
+#endif
+        queued.emplace_back(block, off);
+        cv.notify_all();
+    }
+
+    // Caller holds m. Returns once some write has retired, by this thread or
+    // another. The ring is waited on with m released, so other producers keep
+    // submitting meanwhile.
+    void waitForCompletion(unique_lock<mutex>& lk) {
+#if AITYCOON_HAVE_IO_URING
+        if (useRing) {
+            const uint64_t seen = retired;
+            for (;;) {
+                uint64_t ud; int res;
+                while (ring.popCompletion(ud, res)) {
+                    char* block = (char*)(uintptr_t)ud;
+                    if (res != (int)blockBytes) finishWrite(block, max(res, 0));
+                    freeBuffers.push_back(block);
+                    --outstanding;
+                    ++retired;
+                }
+                if (retired != seen || outstanding == 0 || ringBroken) return;
+                lk.unlock();
+                int r = ring.waitCompletions(1);
+                int err = errno;
+                lk.lock();
+                if (r < 0 && err != EINTR) {
+                    ringBroken = true;
+                    fail(string("io_uring_enter failed: ") + strerror(err));
+                    cv.notify_all();
+                }
+            }
+        }
+#endif
+        cv.wait(lk);
+    }
+
+    // Complete a short or failed ring write synchronously
+    void finishWrite(char* block, size_t done) {
+        TraceBlockHeader h;
+        memcpy(&h, block, sizeof(h));
+        uint64_t off = h.blockIndex * blockBytes;
+        while (done < blockBytes) {
+            ssize_t w = pwrite(fd, block + done, blockBytes - done, (off_t)(off + done));
+            if (w < 0 && errno == EINTR) continue;
+            if (w <= 0) {
+                fail(string("trace write failed: ") + (w < 0 ? strerror(errno) : "no progress"));
+                return;
+            }
+            done += (size_t)w;
+        }
+    }
+
+    void pwriteLoop() {
+        unique_lock<mutex> lk(m);
+        for (;;) {
+            cv.wait(lk, [&] { return stopping || !queued.empty(); });
+            if (queued.empty()) return;
+            auto [block, off] = queued.front();
+            queued.erase(queued.begin());
+            lk.unlock();
+            size_t done = 0;
+            string error;
+            while (done < blockBytes) {
+                ssize_t w = pwrite(fd, block + done, blockBytes - done, (off_t)(off + done));
+                if (w < 0 && errno == EINTR) continue;
+                if (w <= 0) { error = string("trace write failed: ") + (w < 0 ? strerror(errno) : "no progress"); break; }
+                done += (size_t)w;
+            }
+            lk.lock();
+            if (!error.empty()) fail(error);
+            freeBuffers.push_back(block);
+            --outstanding;
+            cv.notify_all();
+        }
+    }
+};
+
+// Monte Carlo run that traces every week of every game
+int runTraceMonteCarlo(const string& path, int games, int inFlight) {
+    WorkerPool pool;
+    TraceSink sink(path, 1 << 20, (unsigned)max(1, inFlight));
+    GameConfig cfg;
+    atomic<long long> weeks{0};
+
+    auto t0 = chrono::steady_clock::now();
+    pool.parallelFor((size_t)games, 256, [&](size_t b, size_t e) {
+        TraceSink::Lane* lane = sink.acquireLane();
+        long long w = 0;
+        for (size_t i = b; i < e; ++i) {
+            uint64_t seed = i + 1;
+            playAutoGame(seed, cfg, [&](const Game& g, const Snapshot& s) {
+                sink.append(*lane, makeTraceRecord(seed, s, g.co.cash));
+                ++w;
+            });
+        }
+        sink.releaseLane(lane);
+        weeks.fetch_add(w, memory_order_relaxed);
+    });
+    sink.close();
+    double secs = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+
+    cout << fixed << setprecision(2);
+    cout << "Traced " << games << " games / " << weeks.load() << " weeks to " << path
+         << " via " << sink.backend() << "\n";
+    cout << "Wrote " << sink.bytesWritten() / 1048576.0 << " MiB in " << secs << " s ("
+         << sink.bytesWritten() / 1048576.0 / max(secs, 1e-9) << " MiB/s, "
+         << games / max(secs, 1e-9) << " games/s)\n";
+    return 0;
+}
+
+// ---------- Live State ----------
+// Seqlock publication of per-game state for dashboards and monitors. The
+// simulation thread is the only writer and never waits; readers copy the
+// payload and retry if a write overlapped. The payload is stored as relaxed
+// atomic words so concurrent copies are well-defined.
+template<class T>
+class SeqlockCell {
+    static_assert(is_trivially_copyable<T>::value, "seqlock payload must be trivially copyable");
+    static_assert(sizeof(T) % 8 == 0, "seqlock payload is copied in whole words");
+public:
+    SeqlockCell() { store(T{}); }
+
+    // Single writer; never blocks
+    void store(const T& v) {
+        const char* src = reinterpret_cast<const char*>(&v);
+        uint32_t s = seq.load(memory_order_relaxed);
+        seq.store(s + 1, memory_order_relaxed);
+        atomic_thread_fence(memory_order_release);
+        for (size_t i = 0; i < kWords; ++i) {
+            uint64_t w;
+            memcpy(&w, src + i * 8, 8);
+            words[i].store(w, memory_order_relaxed);
+        }
+        seq.store(s + 2, memory_order_release);
+    }
+
+    // False if a write was in progress; the caller may retry or skip
+    bool tryLoad(T& out) const {
+        uint32_t s0 = seq.load(memory_order_acquire);
+        if (s0 & 1) return false;
+        uint64_t buf[kWords];
+        for (size_t i = 0; i < kWords; ++i) buf[i] = words[i].load(memory_order_relaxed);
+        atomic_thread_fence(memory_order_acquire);
+        if (seq.load(memory_order_relaxed) != s0) return false;
+        memcpy(&out, buf, sizeof(T));
+        return true;
+    }
+
+    T load() const {
+        T v;
+        while (!tryLoad(v)) this_thread::yield();
+        return v;
+    }
+
+    // Number of completed writes
+    uint32_t version() const { return seq.load(memory_order_acquire) / 2; }
+
+private:
+    static constexpr size_t kWords = sizeof(T) / 8;
+    atomic<uint32_t> seq{0};
+    atomic<uint64_t> words[kWords];
+};
+
+struct LiveGameState {
+    static constexpr int kRecent = 8;
+
+    uint64_t gameId = 0;
+    int week = 0;
+    int inventory = 0;
+    double cash = 0.0;
+    double baseProxy = 0.0;
+    AdvisorWeights weights{};
+    // last kRecent weeks in a ring: week w lives at (w - 1) % kRecent
+    int recentSold[kRecent] = {};
+    double recentProfit[kRecent] = {};
+};
+
+// Keeps the writer-side copy so each week is an incremental update plus one store
+class LivePublisher {
+public:
+    explicit LivePublisher(SeqlockCell<LiveGameState>& cell) : cell(&cell) {}
+
+    void startGame(uint64_t gameId, const Game& g) {
+        state = LiveGameState{};
+        state.gameId = gameId;
+        state.inventory = g.co.inventory;
+        state.cash = g.co.cash;
+        state.baseProxy = g.baseProxy;
+        state.weights = g.ai.weights();
+        cell->store(state);
+    }
+
+    void publish(const Game& g, const Snapshot& s) {
+        int at = (s.week - 1) % LiveGameState::kRecent;
+        state.recentSold[at] = s.sold;
+        state.recentProfit[at] = s.profit;
+        state.week = s.week;
+        state.inventory = g.co.inventory;
+        state.cash = g.co.cash;
+        state.baseProxy = g.baseProxy;
+        state.weights = g.ai.weights();
+        cell->store(state);
+    }
+
+private:
+    SeqlockCell<LiveGameState>* cell;
+    LiveGameState state;
+};
+
+// Plays games with one live slot per worker chunk while a monitor thread
+// samples every slot, then times the publish call on its own.
+int runLiveBench(int games) {
+    WorkerPool pool;
+    const size_t grain = 64;
+    size_t slots = ((size_t)games + grain - 1) / grain;
+    vector<SeqlockCell<LiveGameState>> board(slots);
+    GameConfig cfg;
+
+    atomic<bool> running{true};
+    atomic<long long> reads{0}, torn{0};
+    thread monitor([&] {
+        LiveGameState st;
+        while (running.load(memory_order_relaxed)) {
+            for (auto& cell : board) {
+                if (!cell.tryLoad(st)) continue;
+                ++reads;
+                // profit of the current week can never exceed what its sales could earn
+                if (st.week > 0) {
+                    int at = (st.week - 1) % LiveGameState::kRecent;
+                    if (st.recentProfit[at] > st.recentSold[at] * 40.0) ++torn;
+                }
+            }
+            this_thread::yield();
+        }
+    });
+
+    pool.parallelFor((size_t)games, grain, [&](size_t b, size_t e) {
+        LivePublisher pub(board[b / grain]);
+        for (size_t i = b; i < e; ++i) {
+            Game game(i + 1, cfg);
+            pub.startGame(i + 1, game);
+            for (int w = 1; w <= cfg.weeks; ++w) {
+                MarketEvent ev = game.beginWeek();
+                pub.publish(game, game.resolveWeek(game.advise(ev), ev));
+                if (game.bankrupt()) break;
+            }
+        }
+    });
+
+    running = false;
+    monitor.join();
+
+    // Writer cost on its own
+    const int reps = 5000000;
+    SeqlockCell<LiveGameState> hot;
+    LivePublisher pub(hot);
+    Game game(1, cfg);
+    MarketEvent ev = game.beginWeek();
+    Snapshot snap = game.resolveWeek(game.advise(ev), ev);
+    auto t0 = chrono::steady_clock::now();
+    for (int r = 0; r < reps; ++r) {
+        snap.week = r + 1;
+        pub.publish(game, snap);
+    }
+    double ns = chrono::duration<double, nano>(chrono::steady_clock::now() - t0).count() / reps;
+
+    cout << fixed << setprecision(2);
+    cout << "Live snapshots: " << games << " games over " << slots << " slots, "
+         << reads.load() << " monitor reads, " << torn.load() << " inconsistent\n";
+    cout << "Writer overhead: " << ns << " ns per published week (" << sizeof(LiveGameState) << "-byte state)\n";
+    return 0;
+}
+
+// ---------- Shared-Memory Results Stream ----------
+// Completed weeks and games are published into a POSIX shared-memory ring
+// that other processes map read-only. Writers never wait for readers: the
+// ring overwrites its oldest slots, and every reader keeps its own cursor and
+// notices when it has been lapped. Each slot carries a sequence word
+// (odd while being written) so readers can validate what they copied.
+struct GameRecord {
+    uint64_t gameId;
+    int32_t weeksPlayed;
+    int32_t unitsSold;
+    double totalProfit;
+    double finalCash;
+    uint32_t bankrupt;
+    uint32_t reserved;
+};
+
+enum StreamKind : uint32_t { kStreamWeek = 1, kStreamGame = 2 };
+
+struct StreamRecord {
+    uint32_t kind;
+    uint32_t reserved;
+    union {
+        TraceRecord week;
+        GameRecord game;
+    };
+};
+static_assert(sizeof(StreamRecord) % 8 == 0 && sizeof(StreamRecord) <= 120, "stream record must fit a slot");
+static_assert(atomic<uint64_t>::is_always_lock_free, "stream ring needs address-free 64-bit atomics");
+
+struct StreamSlot {
+    atomic<uint64_t> seq;   // 2n+1 while record n is written, 2n+2 once complete
+    atomic<uint64_t> words[15];
+};
+
+struct StreamHeader {
+    char magic[8];          // "ATSTRM1"
+    uint32_t slotSize;
+    uint32_t capacity;      // power of two
+    atomic<uint64_t> writeIndex;
+    atomic<uint32_t> closed;
+    uint8_t pad[36];
+};
+static_assert(sizeof(StreamHeader) == 64 && sizeof(StreamSlot) == 128, "stream layout is shared across processes");
+
+class ResultStreamWriter {
+public:
+    ResultStreamWriter(const string& name, uint32_t capacity) : name(name) {
+        uint32_t cap = 1;
+        while (cap < capacity) cap <<= 1;
+        bytes = sizeof(StreamHeader) + (size_t)cap * sizeof(StreamSlot);
+        shm_unlink(name.c_str());
+        int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+        if (fd < 0) throw runtime_error("cannot create shared memory " + name);
+        if (ftruncate(fd, (off_t)bytes) != 0) { ::close(fd); throw runtime_error("cannot size shared memory " + name); }
+        void* p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (p == MAP_FAILED) throw runtime_error("cannot map shared memory " + name);
+        // a fresh shm object is zero-filled, which is a valid empty ring
+        hdr = (StreamHeader*)p;
+        slots = (StreamSlot*)((char*)p + sizeof(StreamHeader));
+        hdr->slotSize = sizeof(StreamSlot);
+        hdr->capacity = cap;
+        mask = cap - 1;
+        atomic_thread_fence(memory_order_release);
+        memcpy(hdr->magic, "ATSTRM1", 8);
+    }
+
+    ~ResultStreamWriter() {
+        close();
+        munmap(hdr, bytes);
+    }
+
+    // Safe from many threads at once
+    void publish(const StreamRecord& r) {
+        uint64_t n = hdr->writeIndex.fetch_add(1, memory_order_relaxed);
+        StreamSlot& s = slots[n & mask];
+        // only waits if the writer one full lap behind has not finished
+        uint64_t prev = n > mask ? 2 * (n - mask - 1) + 2 : 0;
+        while (s.seq.load(memory_order_acquire) != prev) this_thread::yield();
+        s.seq.store(2 * n + 1, memory_order_relaxed);
+        atomic_thread_fence(memory_order_release);
+        uint64_t buf[15] = {};
+        memcpy(buf, &r, sizeof(r));
+        for (int i = 0; i < 15; ++i) s.words[i].store(buf[i], memory_order_relaxed);
+        s.seq.store(2 * n + 2, memory_order_release);
+    }
+
+    void close() { hdr->closed.store(1, memory_order_release); }
+    uint64_t published() const { return hdr->writeIndex.load(memory_order_relaxed); }
+
+private:
+    string name;
+    size_t bytes = 0;
+    StreamHeader* hdr = nullptr;
+    StreamSlot* slots = nullptr;
+    uint64_t mask = 0;
+};
+
+class ResultStreamReader {
+public:
+    // Start at the newest record, or at the oldest one still in the ring
+    explicit ResultStreamReader(const string& name, bool fromOldest = false) {
+        int fd = shm_open(name.c_str(), O_RDONLY, 0);
+        if (fd < 0) throw runtime_error("no result stream named " + name);
+        struct stat st;
+        if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(StreamHeader)) {
+            ::close(fd);
+            throw runtime_error("result stream " + name + " is not initialized");
+        }
+        bytes = (size_t)st.st_size;
+        void* p = mmap(nullptr, bytes, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (p == MAP_FAILED) throw runtime_error("cannot map result stream " + name);
+        hdr = (const StreamHeader*)p;
+        if (memcmp(hdr->magic, "ATSTRM1", 8) != 0 || hdr->slotSize != sizeof(StreamSlot)) {
+            munmap(p, bytes);
+            throw runtime_error("result stream " + name + " has an unknown layout");
+        }
+        slots = (const StreamSlot*)((const char*)p + sizeof(StreamHeader));
+        capacity = hdr->capacity;
+        uint64_t w = hdr->writeIndex.load(memory_order_acquire);
+        cursor = fromOldest ? (w > capacity ? w - capacity : 0) : w;
+    }
+
+    ~ResultStreamReader() { munmap((void*)hdr, bytes); }
+
+    // Copy the next record out; false if the reader has caught up
+    bool next(StreamRecord& out) {
+        for (;;) {
+            const StreamSlot& s = slots[cursor & (capacity - 1)];
+            uint64_t want = 2 * cursor + 2;
+            uint64_t s0 = s.seq.load(memory_order_acquire);
+            if (s0 < want) {
+                // not written yet, unless the ring moved a lap past us mid-write
+                if (hdr->writeIndex.load(memory_order_acquire) <= cursor + capacity) return false;
+                skipToOldest();
+                continue;
+            }
+            if (s0 > want) { skipToOldest(); continue; }
+            uint64_t buf[15];
+            for (int i = 0; i < 15; ++i) buf[i] = s.words[i].load(memory_order_relaxed);
+            atomic_thread_fence(memory_order_acquire);
+            if (s.seq.load(memory_order_relaxed) != s0) { skipToOldest(); continue; }
+            memcpy(&out, buf, sizeof(out));
+            ++cursor;
+            return true;
+        }
+    }
+
+    bool closed() const { return hdr->closed.load(memory_order_acquire) != 0; }
+    uint64_t lost() const { return dropped; }
+
+private:
+    size_t bytes = 0;
+    const StreamHeader* hdr = nullptr;
+    const StreamSlot* slots = nullptr;
+    uint64_t capacity = 0;
+    uint64_t cursor = 0;
+    uint64_t dropped = 0;
+
+    void skipToOldest() {
+        uint64_t w = hdr->writeIndex.load(memory_order_acquire);
+        // leave a little slack so we do not land on a slot about to be reused
+        uint64_t oldest = w > capacity ? w - capacity + min<uint64_t>(capacity / 8, 64) : 0;
+        if (oldest > cursor) {
+            dropped += oldest - cursor;
+            cursor = oldest;
+        }
+    }
+};
+
+// Runs a batch and streams every week and game into the named ring
+int runStreamPublisher(const string& name, int games) {
+    ResultStreamWriter out(name, 1 << 16);
+    WorkerPool pool;
+    GameConfig cfg;
+    auto t0 = chrono::steady_clock::now();
+    pool.parallelFor((size_t)games, 64, [&](size_t b, size_t e) {
+        StreamRecord rec{};
+        for (size_t i = b; i < e; ++i) {
+            uint64_t seed = i + 1;
+            GameResult res = playAutoGame(seed, cfg, [&](const Game& g, const Snapshot& s) {
+                rec.kind = kStreamWeek;
+                rec.week = makeTraceRecord(seed, s, g.co.cash);
+                out.publish(rec);
+            });
+            rec.kind = kStreamGame;
+            rec.game = {seed, res.weeksPlayed, res.unitsSold, res.totalProfit, res.finalCash, res.bankrupt ? 1u : 0u, 0};
+            out.publish(rec);
+        }
+    });
+    out.close();
+    double secs = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+    cout << fixed << setprecision(2);
+    cout << "Published " << out.published() << " records for " << games << " games to " << name
+         << " in " << secs << " s\n";
+    // keep the segment around for late readers; the next publisher replaces it
+    return 0;
+}
+
+// Prints records as CSV until the publisher closes the stream
+int runStreamTail(const string& name, bool gamesOnly) {
+    ResultStreamReader in(name, true);
+    StreamRecord r;
+    cout << fixed << setprecision(2);
+    for (;;) {
+        bool wasClosed = in.closed();
+        bool any = false;
+        while (in.next(r)) {
+            any = true;
+            if (r.kind == kStreamGame)
+                cout << "game," << r.game.gameId << "," << r.game.weeksPlayed << "," << r.game.unitsSold << ","
+                     << r.game.totalProfit << "," << r.game.finalCash << "," << r.game.bankrupt << "\n";
+            else if (!gamesOnly)
+                cout << "week," << r.week.gameId << "," << r.week.week << "," << r.week.sold << ","
+                     << r.week.price << "," << r.week.profit << "," << r.week.cash << "\n";
+        }
+        if (wasClosed && !any) break;
+        if (!any) this_thread::sleep_for(chrono::milliseconds(1));
+    }
+    cerr << "stream " << name << " closed; " << in.lost() << " records overwritten before they were read\n";
+    return 0;
+}
+
+// ---------- Networking ----------
+// Small blocking/non-blocking TCP helpers with newline-delimited text messages.
+int listenTcp(int port, bool loopbackOnly = true) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) throw runtime_error("socket() failed");
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((uint16_t)port);
+    addr.sin_addr.s_addr = htonl(loopbackOnly ? INADDR_LOOPBACK : INADDR_ANY);
+    if (::bind(fd, (sockaddr*)&addr, sizeof(addr)) != 0 || ::listen(fd, 128) != 0) {
+        ::close(fd);
+        throw runtime_error("cannot listen on port " + to_string(port));
+    }
+    return fd;
+}
+
+// Port a listening socket ended up on (useful with port 0)
+int boundPort(int fd) {
+    sockaddr_in addr{};
+    socklen_t len = sizeof(addr);
+    getsockname(fd, (sockaddr*)&addr, &len);
+    return ntohs(addr.sin_port);
+}
+
+int connectTcp(const string& host, int port) {
+    addrinfo hints{}, *res = nullptr;
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo(host.c_str(), to_string(port).c_str(), &hints, &res) != 0 || !res)
+        throw runtime_error("cannot resolve " + host);
+    int fd = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+    int rc = fd < 0 ? -1 : ::connect(fd, res->ai_addr, res->ai_addrlen);
+    freeaddrinfo(res);
+    if (rc != 0) {
+        if (fd >= 0) ::close(fd);
+        throw runtime_error("cannot connect to " + host + ":" + to_string(port));
+    }
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    return fd;
+}
+
+void setNonBlocking(int fd) {
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+}
+
+// One TCP peer with buffered input and output
+struct LineConn {
+    int fd = -1;
+    string in, out;
+    size_t scanned = 0;
+
+    // Pops a complete line from the input buffer (without the newline)
+    bool popLine(string& line) {
+        size_t nl = in.find('\n', scanned);
+        if (nl == string::npos) { scanned = in.size(); return false; }
+        line.assign(in, 0, nl);
+        in.erase(0, nl + 1);
+        scanned = 0;
+        return true;
+    }
+
+    // Reads what is available; false on EOF or a hard error
+    bool fill() {
+        char buf[16384];
+        for (;;) {
+            ssize_t r = ::recv(fd, buf, sizeof(buf), 0);
+            if (r > 0) { in.append(buf, (size_t)r); if ((size_t)r < sizeof(buf)) return true; continue; }
+            if (r == 0) return false;
+            if (errno == EINTR) continue;
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+        }
+    }
+
+    // Writes as much buffered output as the socket takes; false on error
+    bool flush() {
+        while (!out.empty()) {
+            ssize_t w = ::send(fd, out.data(), out.size(), 0);
+            if (w > 0) { out.erase(0, (size_t)w); continue; }
+            if (w < 0 && errno == EINTR) continue;
+            return w < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+        }
+        return true;
+    }
+
+    // Blocking line read for simple clients; false on EOF
+    bool readLine(string& line) {
+        while (!popLine(line))
+            if (!fill()) return false;
+        return true;
+    }
+
+    bool sendLine(const string& line) {
+        out += line;
+        out += '\n';
+        return flush();
+    }
+
+    void close() {
+        if (fd >= 0) ::close(fd);
+        fd = -1;
+    }
+};
+
+// ---------- Result Sketches ----------
+// Mergeable summary of many games: moments (Chan et al. merge), extremes and
+// a fixed-range final-cash histogram for quantiles. Sketches from different
+// shards, threads or hosts combine in any order.
+struct ResultSketch {
+    static constexpr int kBins = 64;
+    static constexpr double kLo = -10000.0, kHi = 70000.0;
+
+    uint64_t games = 0;
+    uint64_t bankruptcies = 0;
+    uint64_t unitsSold = 0;
+    double mean = 0.0, m2 = 0.0;   // final cash
+    double minCash = 1e300, maxCash = -1e300;
+    uint64_t hist[kBins] = {};
+
+    void add(const GameResult& r) {
+        ++games;
+        bankruptcies += r.bankrupt;
+        unitsSold += (uint64_t)r.unitsSold;
+        double d = r.finalCash - mean;
+        mean += d / (double)games;
+        m2 += d * (r.finalCash - mean);
+        minCash = min(minCash, r.finalCash);
+        maxCash = max(maxCash, r.finalCash);
+        int b = (int)((r.finalCash - kLo) / (kHi - kLo) * kBins);
+        ++hist[clampv(b, 0, kBins - 1)];
+    }
+
+    void merge(const ResultSketch& o) {
+        if (o.games == 0) return;
+        uint64_t n = games + o.games;
+        double d = o.mean - mean;
+        mean += d * (double)o.games / (double)n;
+        m2 += o.m2 + d * d * (double)games * (double)o.games / (double)n;
+        games = n;
+        bankruptcies += o.bankruptcies;
+        unitsSold += o.unitsSold;
+        minCash = min(minCash, o.minCash);
+        maxCash = max(maxCash, o.maxCash);
+        for (int b = 0; b < kBins; ++b) hist[b] += o.hist[b];
+    }
+
+    double stddev() const { return games > 1 ? sqrt(m2 / (double)(games - 1)) : 0.0; }
+
+    // Final-cash quantile from the histogram (bin midpoint)
+    double quantile(double q) const {
+        uint64_t target = (uint64_t)ceil(q * (double)games), acc = 0;
+        for (int b = 0; b < kBins; ++b) {
+            acc += hist[b];
+            if (acc >= max<uint64_t>(target, 1)) return kLo + (b + 0.5) * (kHi - kLo) / kBins;
+        }
+        return kHi;
+    }
+
+    string serialize() const {
+        ostringstream os;
+        os << setprecision(17) << games << ' ' << bankruptcies << ' ' << unitsSold << ' '
+           << mean << ' ' << m2 << ' ' << minCash << ' ' << maxCash;
+        for (uint64_t h : hist) os << ' ' << h;
+        return os.str();
+    }
+
+    static bool parse(istream& is, ResultSketch& s) {
+        is >> s.games >> s.bankruptcies >> s.unitsSold >> s.mean >> s.m2 >> s.minCash >> s.maxCash;
+        for (uint64_t& h : s.hist) is >> h;
+        return !is.fail();
+    }
+};
+
+// ---------- Distributed Sweep ----------
+// A coordinator hands out shards of (parameter point, seed range) to worker
+// processes over TCP and merges the sketches they return. Protocol, one line
+// per message:
+//   worker -> NEXT <k>                 ask for up to k shards
+//   coord  -> SHARD <id> <point> <firstSeed> <seeds> ... then OK | WAIT | DONE
+//   worker -> RESULT <id> <sketch>     any message also renews the worker's leases
+//   worker -> ALIVE                    heartbeat, sent while a long shard computes
+// A worker whose connection drops or stays silent for the lease period loses
+// its shards to the queue; duplicate results of re-issued shards are ignored.
+struct SweepPoint {
+    double priceSensitivity;
+    double adEffect;
+    double noiseStd;
+};
+
+vector<SweepPoint> defaultSweepGrid() {
+    vector<SweepPoint> pts;
+    for (double ps : {1.0, 1.2, 1.4, 1.6, 1.8})
+        for (double ae : {7.0, 9.0, 11.0})
+            for (double ns : {3.0, 6.0, 9.0})
+                pts.push_back({ps, ae, ns});
+    return pts;
+}
+
+GameConfig configFor(const SweepPoint& p) {
+    GameConfig cfg;
+    cfg.market.priceSensitivity = p.priceSensitivity;
+    cfg.market.adEffect = p.adEffect;
+    cfg.market.noiseStd = p.noiseStd;
+    return cfg;
+}
+
+struct SweepShard {
+    int point;
+    uint64_t firstSeed;
+    int seeds;
+};
+
+// onGame() runs after every game of the shard
+template<class OnGame>
+ResultSketch runSweepShard(const vector<SweepPoint>& grid, const SweepShard& s, OnGame&& onGame) {
+    ResultSketch sk;
+    GameConfig cfg = configFor(grid[s.point]);
+    for (int i = 0; i < s.seeds; ++i) {
+        sk.add(playAutoGame(s.firstSeed + (uint64_t)i, cfg));
+        onGame();
+    }
+    return sk;
+}
+
+ResultSketch runSweepShard(const vector<SweepPoint>& grid, const SweepShard& s) {
+    return runSweepShard(grid, s, [] {});
+}
+
+class SweepCoordinator {
+public:
+    SweepCoordinator(const vector<SweepPoint>& grid, int shardsPerPoint, int seedsPerShard, int leaseMs)
+        : results(grid.size()), leaseMs(leaseMs)
+    {
+        for (int p = 0; p < (int)grid.size(); ++p)
+            for (int k = 0; k < shardsPerPoint; ++k) {
+                shards.push_back({p, (uint64_t)k * (uint64_t)seedsPerShard + 1, seedsPerShard});
+                pending.push_back((int)shards.size() - 1);
+            }
+        state.assign(shards.size(), Pending);
+        owner.assign(shards.size(), -1);
+    }
+
+    // Serve workers on listenFd until every shard has a result
+    void run(int listenFd) {
+        setNonBlocking(listenFd);
+        vector<pollfd> pfds;
+        auto lastScan = chrono::steady_clock::now();
+        while (done < shards.size()) {
+            pfds.clear();
+            pfds.push_back({listenFd, POLLIN, 0});
+            for (auto& c : conns) pfds.push_back({c.io.fd, (short)(POLLIN | (c.io.out.empty() ? 0 : POLLOUT)), 0});
+            poll(pfds.data(), pfds.size(), 50);
+
+            if (pfds[0].revents & POLLIN) acceptAll(listenFd);
+            auto now = chrono::steady_clock::now();
+            for (size_t i = 1; i < pfds.size(); ++i) {
+                Conn& c = conns[i - 1];
+                if (pfds[i].revents & (POLLIN | POLLHUP | POLLERR)) {
+                    if (!c.io.fill()) { c.dead = true; continue; }
+                    c.lastSeen = now;
+                    string line;
+                    while (c.io.popLine(line)) handle(c, line);
+                }
+                if (!c.io.flush()) c.dead = true;
+            }
+            if (now - lastScan > chrono::milliseconds(100)) {
+                lastScan = now;
+                for (auto& c : conns)
+                    if (!c.leases.empty() && now - c.lastSeen > chrono::milliseconds(leaseMs)) c.dead = true;
+            }
+            reap();
+        }
+        for (auto& c : conns) { c.io.out += "DONE\n"; c.io.flush(); c.io.close(); }
+        conns.clear();
+    }
+
+    const vector<ResultSketch>& pointResults() const { return results; }
+    size_t shardCount() const { return shards.size(); }
+    size_t reissued() const { return reissues; }
+    int workersSeen() const { return nextConnId; }
+
+private:
+    enum ShardState : uint8_t { Pending, Leased, Done };
+    struct Conn {
+        int id;
+        LineConn io;
+        vector<int> leases;
+        chrono::steady_clock::time_point lastSeen;
+        bool dead = false;
+    };
+
+    vector<SweepShard> shards;
+    vector<ShardState> state;
+    vector<int> owner;
+    deque<int> pending;
+    vector<ResultSketch> results;
+    vector<Conn> conns;
+    size_t done = 0, reissues = 0;
+    int nextConnId = 0;
+    int leaseMs;
+
+    void acceptAll(int listenFd) {
+        for (;;) {
+            int fd = accept(listenFd, nullptr, nullptr);
+            if (fd < 0) return;
+            setNonBlocking(fd);
+            Conn c;
+            c.id = nextConnId++;
+            c.io.fd = fd;
+            c.lastSeen = chrono::steady_clock::now();
+            conns.push_back(move(c));
+        }
+    }
+
+    void handle(Conn& c, const string& line) {
+        istringstream is(line);
+        string cmd;
+        is >> cmd;
+        if (cmd == "NEXT") {
+            int k = 1;
+            is >> k;
+            int issued = 0;
+            while (issued < k && !pending.empty()) {
+                int id = pending.front();
+                pending.pop_front();
+                if (state[id] != Pending) continue;
+                state[id] = Leased;
+                owner[id] = c.id;
+                c.leases.push_back(id);
+                const SweepShard& s = shards[id];
+                c.io.out += "SHARD " + to_string(id) + " " + to_string(s.point) + " "
+                          + to_string(s.firstSeed) + " " + to_string(s.seeds) + "\n";
+                ++issued;
+            }
+            c.io.out += issued ? "OK\n" : (done == shards.size() ? "DONE\n" : "WAIT\n");
+        } else if (cmd == "RESULT") {
+            int id = -1;
+            ResultSketch sk;
+            if (!(is >> id) || id < 0 || id >= (int)shards.size() || !ResultSketch::parse(is, sk)) {
+                c.dead = true;
+                return;
+            }
+            auto it = find(c.leases.begin(), c.leases.end(), id);
+            if (it != c.leases.end()) c.leases.erase(it);
+            if (state[id] == Done) return;
+            state[id] = Done;
+            results[shards[id].point].merge(sk);
+            ++done;
+        }
+    }
+
+    // Drop dead workers and put their unfinished shards back in front
+    void reap() {
+        for (auto& c : conns) {
+            if (!c.dead) continue;
+            for (int id : c.leases)
+                if (state[id] == Leased && owner[id] == c.id) {
+                    state[id] = Pending;
+                    pending.push_front(id);
+                    ++reissues;
+                }
+            c.io.close();
+        }
+        conns.erase(remove_if(conns.begin(), conns.end(), [](const Conn& c) { return c.dead; }), conns.end());
+    }
+};
+
+int runSweepWorker(const string& host, int port) {
+    const int kHeartbeatMs = 1000; // well inside the coordinator's lease
+    vector<SweepPoint> grid = defaultSweepGrid();
+    LineConn io;
+    io.fd = connectTcp(host, port);
+    deque<SweepShard> todo;
+    deque<int> ids;
+    bool asked = false;
+    auto ask = [&] { io.sendLine("NEXT 4"); asked = true; };
+
+    ask();
+    string line;
+    for (;;) {
+        // Block for replies only when there is nothing to compute
+        while (asked && (todo.empty() || io.in.find('\n') != string::npos)) {
+            if (!io.readLine(line)) { io.close(); return 1; }
+            istringstream is(line);
+            string cmd;
+            is >> cmd;
+            if (cmd == "SHARD") {
+                SweepShard s;
+                int id;
+                is >> id >> s.point >> s.firstSeed >> s.seeds;
+                todo.push_back(s);
+                ids.push_back(id);
+            } else if (cmd == "OK") {
+                asked = false;
+            } else if (cmd == "WAIT") {
+                asked = false;
+                if (todo.empty()) { this_thread::sleep_for(chrono::milliseconds(20)); ask(); }
+            } else if (cmd == "DONE") {
+                io.close();
+                return 0;
+            }
+        }
+        if (todo.empty()) { if (!asked) ask(); continue; }
+
+        SweepShard s = todo.front();
+        int id = ids.front();
+        todo.pop_front();
+        ids.pop_front();
+        if (s.point < 0 || s.point >= (int)grid.size()) continue;
+        // Heartbeats keep the leases of a long shard alive
+        auto lastSent = chrono::steady_clock::now();
+        bool lost = false;
+        ResultSketch sk = runSweepShard(grid, s, [&] {
+            auto now = chrono::steady_clock::now();
+            if (lost || now - lastSent < chrono::milliseconds(kHeartbeatMs)) return;
+            io.out += "ALIVE\n";
+            lost = !io.flush();
+            lastSent = now;
+        });
+        if (lost) { io.close(); return 1; }
+        io.out += "RESULT " + to_string(id) + " " + sk.serialize() + "\n";
+        if (todo.size() < 2 && !asked) { io.out += "NEXT 4\n"; asked = true; }
+        if (!io.flush()) { io.close(); return 1; }
+    }
+}
+
+void printSweepTable(const vector<SweepPoint>& grid, const vector<ResultSketch>& res) {
+    cout << fixed << setprecision(2);
+    cout << " priceSens  adEffect  noiseStd |   games  meanCash   stdCash   p10Cash   p50Cash   p90Cash  bankrupt%\n";
+    for (size_t p = 0; p < grid.size(); ++p) {
+        const ResultSketch& r = res[p];
+        cout << setw(10) << grid[p].priceSensitivity << setw(10) << grid[p].adEffect << setw(10) << grid[p].noiseStd
+             << " | " << setw(7) << r.games << setw(10) << r.mean << setw(10) << r.stddev()
+             << setw(10) << r.quantile(0.1) << setw(10) << r.quantile(0.5) << setw(10) << r.quantile(0.9)
+             << setw(10) << (r.games ? 100.0 * r.bankruptcies / r.games : 0.0) << "\n";
+    }
+}
+
+double processCpuSeconds() {
+    rusage ru{};
+    getrusage(RUSAGE_SELF, &ru);
+    return ru.ru_utime.tv_sec + ru.ru_stime.tv_sec + (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) * 1e-6;
+}
+
+int runSweepCoordinator(int port, int shardsPerPoint, int seedsPerShard, int localWorkers) {
+    signal(SIGPIPE, SIG_IGN);
+    vector<SweepPoint> grid = defaultSweepGrid();
+    int lfd = listenTcp(port, localWorkers > 0);
+    port = boundPort(lfd);
+
+    vector<pid_t> kids;
+    for (int w = 0; w < localWorkers; ++w) {
+        pid_t pid = fork();
+        if (pid == 0) {
+            ::close(lfd);
+            _exit(runSweepWorker("127.0.0.1", port));
+        }
+        if (pid > 0) kids.push_back(pid);
+    }
+    if (localWorkers == 0) cout << "Coordinator listening on port " << port << "\n";
+
+    SweepCoordinator coord(grid, shardsPerPoint, seedsPerShard, 30000);
+    double cpu0 = processCpuSeconds();
+    auto t0 = chrono::steady_clock::now();
+    coord.run(lfd);
+    double secs = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+    double cpu = processCpuSeconds() - cpu0;
+    ::close(lfd);
+    for (pid_t pid : kids) waitpid(pid, nullptr, 0);
+
+    printSweepTable(grid, coord.pointResults());
+    cout << "Shards: " << coord.shardCount() << " (" << coord.reissued() << " re-issued) from "
+         << coord.workersSeen() << " workers in " << secs << " s\n";
+    cout << "Coordinator CPU: " << cpu * 1e6 / max<size_t>(1, coord.shardCount()) << " us/shard ("
+         << coord.shardCount() / max(secs, 1e-9) << " shards/s)\n";
+    return 0;
+}
+
+// ---------- Multiplayer Rooms ----------
+// Many rooms, each with several sellers (bots or humans) sharing one Market.
+// A room's week closes on a deadline held in a hashed timer wheel. Every
+// server tick takes all due rooms at once: markets and events advance, then
+// advice for every seat that needs it is computed as one batch, then the
+// shared demand split and books are resolved room by room, each phase
+// spread over the worker pool. Room state lives in a fixed pool of compact
+// structs recycled through a free list.
+class TimerWheel {
+public:
+    TimerWheel(uint32_t slots, uint64_t slotMs) : wheel(slots), slotMs(max<uint64_t>(1, slotMs)) {}
+
+    void schedule(uint32_t id, uint64_t dueMs) {
+        wheel[(max(dueMs, cursorMs) / slotMs) % wheel.size()].push_back({dueMs, id});
+    }
+
+    // Appends every id due at or before nowMs
+    void advance(uint64_t nowMs, vector<uint32_t>& due) {
+        uint64_t endSlot = nowMs / slotMs;
+        uint64_t slot = cursorMs / slotMs;
+        for (uint64_t steps = 0; slot <= endSlot && steps < wheel.size(); ++slot, ++steps) {
+            auto& bucket = wheel[slot % wheel.size()];
+            size_t keep = 0;
+            for (auto& e : bucket) {
+                if (e.first <= nowMs) due.push_back(e.second);
+                else bucket[keep++] = e; // a later revolution
+            }
+            bucket.resize(keep);
+        }
+        cursorMs = nowMs + 1;
+    }
+
+private:
+    vector<vector<pair<uint64_t, uint32_t>>> wheel;
+    uint64_t slotMs;
+    uint64_t cursorMs = 0;
+};
+
+struct RoomSeat {
+    AIAdvisor ai;              // bot brain; also plays for humans who miss a deadline
+    Plan plan{20, 1000, 50};
+    double cash = 20000.0;
+    double baseProxy = 50.0;
+    int inventory = 40;
+    int lastSold = 0;
+    double lastProfit = 0.0;
+    int recentSold[3] = {};    // for the moving-average proxy
+    int client = -1;           // connection id of a seated human, -1 for bots
+    bool humanSeat = false;
+    bool submitted = false;    // a human plan arrived for the coming deadline
+};
+
+struct Room {
+    static constexpr int kMaxSeats = 4;
+    Market market;
+    MarketEvent event{};
+    FastRng rng;
+    uint64_t dueMs = 0;
+    uint32_t periodMs = 1000;
+    uint16_t week = 0;
+    uint16_t weeks = 12;
+    uint8_t seats = 0;
+    bool active = false;
+    RoomSeat seat[kMaxSeats];
+};
+
+struct SeatReport {
+    uint32_t room;
+    int seat;
+    int client;
+};
+
+class RoomServer {
+public:
+    RoomServer(uint32_t capacity, WorkerPool& pool) : rooms(capacity), wheel(4096, 1), pool(pool) {
+        for (uint32_t i = capacity; i-- > 0;) freeRooms.push_back(i);
+    }
+
+    // Opens a room starting at nowMs; returns its id or -1 if the pool is full
+    int openRoom(int bots, int humanSeats, uint32_t periodMs, uint64_t nowMs, uint64_t seed) {
+        if (freeRooms.empty() || bots + humanSeats < 1 || bots + humanSeats > Room::kMaxSeats) return -1;
+        uint32_t id = freeRooms.back();
+        freeRooms.pop_back();
+        Room& r = rooms[id];
+        r = Room{};
+        r.rng = FastRng(seed);
+        r.periodMs = periodMs;
+        r.seats = (uint8_t)(bots + humanSeats);
+        r.active = true;
+        for (int s = bots; s < r.seats; ++s) r.seat[s].humanSeat = true;
+        r.dueMs = nowMs + periodMs;
+        wheel.schedule(id, r.dueMs);
+        ++activeRooms;
+        return (int)id;
+    }
+
+    // Seats a client in the first free human seat
+    bool join(int client, uint32_t& roomOut, int& seatOut) {
+        for (uint32_t id = 0; id < rooms.size(); ++id) {
+            Room& r = rooms[id];
+            if (!r.active) continue;
+            for (int s = 0; s < r.seats; ++s)
+                if (r.seat[s].humanSeat && r.seat[s].client < 0) {
+                    r.seat[s].client = client;
+                    roomOut = id;
+                    seatOut = s;
+                    return true;
+                }
+        }
+        return false;
+    }
+
+    void leave(int client) {
+        for (auto& r : rooms)
+            for (int s = 0; s < r.seats; ++s)
+                if (r.seat[s].client == client) r.seat[s].client = -1;
+    }
+
+    // Thread-safe: a human plan for the room's next deadline
+    void submitPlan(uint32_t room, int seat, const Plan& p) {
+        lock_guard<mutex> lk(inboxMutex);
+        inbox.push_back({room, seat, p});
+    }
+
+    const Room& room(uint32_t id) const { return rooms[id]; }
+    size_t active() const { return activeRooms; }
+    uint64_t weeksResolved() const { return resolved; }
+    uint64_t maxLagMs() const { return worstLag; }
+
+    // Resolve every room whose deadline passed. Seats with a client get a report.
+    void tick(uint64_t nowMs, vector<SeatReport>* reports = nullptr) {
+        {
+            lock_guard<mutex> lk(inboxMutex);
+            for (auto& m : inbox) {
+                if (m.room >= rooms.size() || !rooms[m.room].active || m.seat < 0 || m.seat >= rooms[m.room].seats) continue;
+                RoomSeat& st = rooms[m.room].seat[m.seat];
+                if (!st.humanSeat) continue;
+                st.plan = {clampv(m.plan.price, 9.0, 40.0), clampv(m.plan.adSpend, 0.0, 10000.0),
+                           clampv(m.plan.production, 0, 200)};
+                st.submitted = true;
+            }
+            inbox.clear();
+        }
+        due.clear();
+        wheel.advance(nowMs, due);
+        if (due.empty()) return;
+
+        // 1) Markets drift and draw events
+        pool.parallelFor(due.size(), 256, [&](size_t b, size_t e) {
+            for (size_t i = b; i < e; ++i) {
+                Room& r = rooms[due[i]];
+                ++r.week;
+                r.market.drift(r.rng);
+                r.event = r.market.nextEvent(r.week, r.rng);
+            }
+        });
+
+        // 2) Advice for every seat without a submitted plan, as one SuggestBatch
+        //    per chunk so seats facing the same event share a search table
+        advice.clear();
+        for (uint32_t id : due) {
+            Room& r = rooms[id];
+            for (int s = 0; s < r.seats; ++s)
+                if (!r.seat[s].submitted) advice.push_back({id, s});
+        }
+        Company defaults;
+        pool.parallelFor(advice.size(), 64, [&](size_t b, size_t e) {
+            thread_local SuggestBatch batch;
+            batch.clear();
+            for (size_t i = b; i < e; ++i) {
+                const Room& r = rooms[advice[i].first];
+                const RoomSeat& st = r.seat[advice[i].second];
+                batch.add({st.ai.weights(), st.inventory, defaults.unitCost, defaults.fixedCost, st.baseProxy,
+                           r.event.adShock, r.event.priceShock});
+            }
+            const vector<Plan>& plans = batch.solve();
+            for (size_t i = b; i < e; ++i) rooms[advice[i].first].seat[advice[i].second].plan = plans[i - b];
+        });
+
+        // 3) Split shared demand and book every seat
+        pool.parallelFor(due.size(), 256, [&](size_t b, size_t e) {
+            for (size_t i = b; i < e; ++i) resolveRoom(rooms[due[i]], defaults);
+        });
+
+        for (uint32_t id : due) {
+            Room& r = rooms[id];
+            worstLag = max(worstLag, nowMs - r.dueMs);
+            ++resolved;
+            if (reports)
+                for (int s = 0; s < r.seats; ++s)
+                    if (r.seat[s].client >= 0) reports->push_back({id, s, r.seat[s].client});
+            if (r.week < r.weeks) {
+                r.dueMs += r.periodMs;
+                wheel.schedule(id, max(r.dueMs, nowMs + 1));
+            } else {
+                r.active = false;
+                freeRooms.push_back(id);
+                --activeRooms;
+            }
+        }
+    }
+
+    // Split shared demand and book every seat of one room
+    static void resolveRoom(Room& r, const Company& defaults) {
+        Plan plans[Room::kMaxSeats] = {};
+        int avail[Room::kMaxSeats] = {}, sold[Room::kMaxSeats] = {};
+        for (int s = 0; s < r.seats; ++s) {
+            RoomSeat& st = r.seat[s];
+            plans[s] = st.plan;
+            st.inventory += st.plan.production;
+            avail[s] = st.inventory;
+        }
+        r.market.realizeSharedDemand(r.seats, plans, avail, r.event, r.rng, sold);
+        for (int s = 0; s < r.seats; ++s) {
+            RoomSeat& st = r.seat[s];
+            int units = min(sold[s], st.inventory);
+            st.inventory -= units;
+            double profit = units * st.plan.price
+                          - (st.plan.production * defaults.unitCost + st.plan.adSpend + defaults.fixedCost);
+            st.cash += profit;
+            st.lastSold = units;
+            st.lastProfit = profit;
+            st.ai.learn(st.plan.price, st.plan.adSpend, st.baseProxy, st.inventory + units, units,
+                        r.event.adShock, r.event.priceShock);
+            st.recentSold[(r.week - 1) % 3] = units;
+            int n = min<int>(r.week, 3);
+            double avgSales = 0.0;
+            for (int k = 0; k < n; ++k) avgSales += st.recentSold[k];
+            avgSales /= n;
+            st.baseProxy = max(0.0, 0.70 * st.baseProxy + 0.30 * avgSales + simNormal(r.rng, 0.0, 3.0));
+            st.submitted = false;
+        }
+    }
+
+private:
+    struct PendingPlan {
+        uint32_t room;
+        int seat;
+        Plan plan;
+    };
+
+    vector<Room> rooms;
+    vector<uint32_t> freeRooms;
+    TimerWheel wheel;
+    WorkerPool& pool;
+    mutex inboxMutex;
+    vector<PendingPlan> inbox;
+    vector<uint32_t> due;
+    vector<pair<uint32_t, int>> advice;
+    size_t activeRooms = 0;
+    uint64_t resolved = 0;
+    uint64_t worstLag = 0;
+};
+
+// Keeps `rooms` bot rooms alive (finished rooms are replaced) and reports
+// throughput and how late deadlines were served.
+int runRoomsBench(int rooms, int seconds, int seats, int periodMs) {
+    WorkerPool pool;
+    RoomServer server((uint32_t)rooms, pool);
+    auto t0 = chrono::steady_clock::now();
+    auto nowMs = [&] { return (uint64_t)chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - t0).count(); };
+    uint64_t seed = 1;
+    for (int i = 0; i < rooms; ++i)
+        server.openRoom(seats, 0, (uint32_t)periodMs, (uint64_t)i * periodMs / rooms, seed++);
+
+    double busyMs = 0.0;
+    long long ticks = 0;
+    while (nowMs() < (uint64_t)seconds * 1000) {
+        auto a = chrono::steady_clock::now();
+        server.tick(nowMs());
+        busyMs += chrono::duration<double, milli>(chrono::steady_clock::now() - a).count();
+        ++ticks;
+        while (server.active() < (size_t)rooms) server.openRoom(seats, 0, (uint32_t)periodMs, nowMs(), seed++);
+        this_thread::sleep_for(chrono::milliseconds(1));
+    }
+    double secs = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+    cout << fixed << setprecision(2);
+    cout << "Rooms: " << rooms << " x " << seats << " seats, week every " << periodMs << " ms, "
+         << pool.size() << " threads\n";
+    cout << "Resolved " << server.weeksResolved() << " room-weeks in " << secs << " s ("
+         << server.weeksResolved() / secs << "/s), busy " << 100.0 * busyMs / (secs * 1000.0)
+         << "% over " << ticks << " ticks, worst deadline lag " << server.maxLagMs() << " ms\n";
+    return 0;
+}
+
+// Rooms with bot seats plus one human seat each. Clients speak lines:
+//   JOIN                      -> SEAT <room> <seat> | FULL
+//   PLAN <price> <ad> <units> -> plan for the next deadline (else the bot plays)
+//   server pushes WEEK <week> <sold> <profit> <cash> <inventory> after each deadline
+int runRoomsServer(int port, int rooms, int bots, int periodMs) {
+    signal(SIGPIPE, SIG_IGN);
+    WorkerPool pool;
+    RoomServer server((uint32_t)rooms, pool);
+    int lfd = listenTcp(port, false);
+    setNonBlocking(lfd);
+    auto t0 = chrono::steady_clock::now();
+    auto nowMs = [&] { return (uint64_t)chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - t0).count(); };
+    uint64_t seed = 1;
+    for (int i = 0; i < rooms; ++i) server.openRoom(bots, 1, (uint32_t)periodMs, nowMs(), seed++);
+    cout << "Rooms server on port " << boundPort(lfd) << " with " << rooms << " rooms\n" << flush;
+
+    struct Client { int id; LineConn io; bool seated = false; uint32_t room = 0; int seat = 0; bool dead = false; };
+    vector<Client> clients;
+    int nextId = 0;
+    vector<pollfd> pfds;
+    vector<SeatReport> reports;
+    for (;;) {
+        pfds.clear();
+        pfds.push_back({lfd, POLLIN, 0});
+        for (auto& c : clients) pfds.push_back({c.io.fd, (short)(POLLIN | (c.io.out.empty() ? 0 : POLLOUT)), 0});
+        poll(pfds.data(), pfds.size(), 1);
+        if (pfds[0].revents & POLLIN) {
+            int fd;
+            while ((fd = accept(lfd, nullptr, nullptr)) >= 0) {
+                setNonBlocking(fd);
+                Client c;
+                c.id = nextId++;
+                c.io.fd = fd;
+                clients.push_back(move(c));
+            }
+        }
+        for (size_t i = 1; i < pfds.size(); ++i) {
+            Client& c = clients[i - 1];
+            if (!(pfds[i].revents & (POLLIN | POLLHUP | POLLERR))) continue;
+            if (!c.io.fill()) { c.dead = true; continue; }
+            string line;
+            while (c.io.popLine(line)) {
+                istringstream is(line);
+                string cmd;
+                is >> cmd;
+                if (cmd == "JOIN" && !c.seated) {
+                    c.seated = server.join(c.id, c.room, c.seat);
+                    c.io.out += c.seated ? "SEAT " + to_string(c.room) + " " + to_string(c.seat) + "\n" : "FULL\n";
+                } else if (cmd == "PLAN" && c.seated) {
+                    Plan p{20, 1000, 50};
+                    if (is >> p.price >> p.adSpend >> p.production) server.submitPlan(c.room, c.seat, p);
+                }
+            }
+        }
+
+        reports.clear();
+        server.tick(nowMs(), &reports);
+        for (const SeatReport& rep : reports) {
+            auto it = find_if(clients.begin(), clients.end(), [&](const Client& c) { return c.id == rep.client; });
+            if (it == clients.end()) continue;
+            const Room& r = server.room(rep.room);
+            const RoomSeat& st = r.seat[rep.seat];
+            ostringstream os;
+            os << fixed << setprecision(2) << "WEEK " << r.week << " " << st.lastSold << " " << st.lastProfit
+               << " " << st.cash << " " << st.inventory << "\n";
+            it->io.out += os.str();
+            if (!r.active) it->seated = false;
+        }
+        while (server.active() < (size_t)rooms) server.openRoom(bots, 1, (uint32_t)periodMs, nowMs(), seed++);
+
+        for (auto& c : clients)
+            if (!c.dead && !c.io.flush()) c.dead = true;
+        for (auto& c : clients)
+            if (c.dead) { server.leave(c.id); c.io.close(); }
+        clients.erase(remove_if(clients.begin(), clients.end(), [](const Client& c) { return c.dead; }), clients.end());
+    }
+}
+
+// ---------- Leaderboard ----------
+// Concurrent top-K of games by a score (final cash or total profit). Each
+// submitter owns a slot with a private min-heap; a submission that cannot
+// enter the slot's top K is rejected with one compare. Accepted entries are
+// republished through a seqlock in batches (every kPublishEvery accepted
+// entries, when the last publish is kPublishMs old, and on flush or release),
+// so readers merge all slots lazily, never block the submitters, and see a
+// slot at most a batch behind.
+struct LeaderEntry {
+    double score;
+    uint64_t gameId;
+    double finalCash;
+    double totalProfit;
+};
+
+template<int K>
+class Leaderboard {
+    struct Slot;
+public:
+    struct LocalTop {
+        uint32_t count = 0;
+        uint32_t reserved = 0;
+        LeaderEntry e[K] = {};
+    };
+
+    static constexpr uint32_t kPublishEvery = 32;
+    static constexpr int kPublishMs = 2;
+
+    // Exclusive use of one slot; the slot keeps its entries after release
+    class Submitter {
+    public:
+        Submitter(Submitter&& o) noexcept : slot(o.slot), pending(o.pending), lastPublish(o.lastPublish) {
+            o.slot = nullptr;
+        }
+        Submitter(const Submitter&) = delete;
+        Submitter& operator=(const Submitter&) = delete;
+        ~Submitter() {
+            if (!slot) return;
+            flush();
+            slot->owned.store(false, memory_order_release);
+        }
+
+        // Makes every accepted entry visible to readers now
+        void flush() {
+            if (pending == 0) return;
+            slot->published.store(slot->heap);
+            pending = 0;
+            lastPublish = chrono::steady_clock::now();
+        }
+
+        void submit(const LeaderEntry& x) {
+            LocalTop& h = slot->heap;
+            auto worse = [](const LeaderEntry& a, const LeaderEntry& b) { return a.score > b.score; };
+            if (h.count == K) {
+                if (x.score <= h.e[0].score) return; // fast path: not in this slot's top K
+                pop_heap(h.e, h.e + K, worse);
+                h.e[K - 1] = x;
+                push_heap(h.e, h.e + K, worse);
+            } else {
+                h.e[h.count++] = x;
+                push_heap(h.e, h.e + h.count, worse);
+            }
+            // the clock is only read for accepted entries, which get rare once the heap is full
+            if (++pending >= kPublishEvery || chrono::steady_clock::now() - lastPublish >= chrono::milliseconds(kPublishMs))
+                flush();
+        }
+
+    private:
+        friend class Leaderboard;
+        Slot* slot;
+        uint32_t pending = 0; // accepted since the last publish
+        chrono::steady_clock::time_point lastPublish;
+        explicit Submitter(Slot* s) : slot(s), lastPublish(chrono::steady_clock::now()) {}
+    };
+
+    explicit Leaderboard(int maxSubmitters = 256) : slots(maxSubmitters) {}
+
+    // Claims a free slot; throws if all are in use
+    Submitter submitter() {
+        for (auto& s : slots) {
+            bool expected = false;
+            if (!s.owned.load(memory_order_relaxed)
+                && s.owned.compare_exchange_strong(expected, true, memory_order_acquire))
+                return Submitter(&s);
+        }
+        throw runtime_error("leaderboard has no free submitter slots");
+    }
+
+    // Best n entries across all slots, best first
+    vector<LeaderEntry> top(size_t n = K) const {
+        vector<LeaderEntry> all;
+        LocalTop t;
+        for (auto& s : slots) {
+            t = s.published.load();
+            all.insert(all.end(), t.e, t.e + t.count);
+        }
+        n = min(n, all.size());
+        partial_sort(all.begin(), all.begin() + n, all.end(),
+                     [](const LeaderEntry& a, const LeaderEntry& b) { return a.score > b.score; });
+        all.resize(n);
+        return all;
+    }
+
+private:
+    struct Slot {
+        atomic<bool> owned{false};
+        LocalTop heap;                      // writer-private
+        SeqlockCell<LocalTop> published;    // what readers see
+    };
+    vector<Slot> slots;
+};
+
+int runLeaderboardBench(int games) {
+    WorkerPool pool;
+    Leaderboard<100> board;
+
+    // Synthetic scores: raw submission cost with a reader merging the top 100
+    const size_t subs = 20000000;
+    atomic<bool> reading{true};
+    atomic<long long> reads{0};
+    thread reader([&] {
+        while (reading.load(memory_order_relaxed)) {
+            board.top(100);
+            ++reads;
+            this_thread::sleep_for(chrono::milliseconds(1));
+        }
+    });
+    auto t0 = chrono::steady_clock::now();
+    pool.parallelFor(subs, 1 << 20, [&](size_t b, size_t e) {
+        auto sub = board.submitter();
+        FastRng g(b + 1);
+        normal_distribution<double> cash(10000.0, 3000.0);
+        for (size_t i = b; i < e; ++i) {
+            double c = cash(g);
+            sub.submit({c, i, c, c - 20000.0});
+        }
+    });
+    double ns = chrono::duration<double, nano>(chrono::steady_clock::now() - t0).count() / subs;
+    reading = false;
+    reader.join();
+    cout << fixed << setprecision(2);
+    cout << "Synthetic: " << subs << " submissions at " << ns << " ns each (incl. score draw), "
+         << reads.load() << " concurrent top-100 reads\n";
+
+    // Real games ranked by final cash
+    Leaderboard<100> games100;
+    GameConfig cfg;
+    pool.parallelFor((size_t)games, 64, [&](size_t b, size_t e) {
+        auto sub = games100.submitter();
+        for (size_t i = b; i < e; ++i) {
+            GameResult r = playAutoGame(i + 1, cfg);
+            sub.submit({r.finalCash, r.seed, r.finalCash, r.totalProfit});
+        }
+    });
+    cout << "Top 10 of " << games << " games by final cash:\n";
+    int rank = 1;
+    for (const LeaderEntry& x : games100.top(10))
+        cout << "  #" << rank++ << " seed " << x.gameId << " | Final Cash: $" << x.finalCash
+             << " | Total Profit: $" << x.totalProfit << "\n";
+    return 0;
+}
+
+// ---------- Market Benchmark ----------
+// The policy-built Market against a hand-written copy of the original
+// hardcoded struct: same draws, same results, same cost.
+struct HardcodedMarket {
+    double baseDemand = 60.0;
+    double priceSensitivity = 1.4;
+    double adEffect = 9.0;
+    double demandDrift = 0.2;
+    double noiseStd = 6.0;
+
+    void drift(Rng& rng) {
+        baseDemand = max(5.0, baseDemand + demandDrift + simNormal(rng, 0.0, 0.8));
+    }
+
+    int realizeDemand(double price, double adSpend, const MarketEvent& ev, int inventoryAvail, Rng& rng) {
+        double priceMult = 1.0 + ev.priceShock;
+        double adMult = 1.0 + ev.adShock;
+        double mu = baseDemand + ev.baseShock
+                    - priceSensitivity * price * priceMult
+                    + adEffect * simLog1p(adSpend) * adMult
+                    + 0.08 * (double)inventoryAvail;
+        double demand = max(0.0, mu + simNormal(rng, 0.0, noiseStd));
+        return (int)floor(demand + 0.5);
+    }
+};
+
+template<class M>
+pair<double, long long> timeMarket(M mk, int weeks) {
+    Rng rng(99);
+    const MarketEvent ev{"Viral Trend", +20.0, +0.50, -0.10};
+    long long checksum = 0;
+    auto t0 = chrono::steady_clock::now();
+    for (int w = 0; w < weeks; ++w) {
+        mk.drift(rng);
+        for (int k = 0; k < 16; ++k)
+            checksum += mk.realizeDemand(9.0 + 2.0 * k, 500.0 * k, ev, 40 + k, rng);
+    }
+    double ns = chrono::duration<double, nano>(chrono::steady_clock::now() - t0).count() / (weeks * 16.0);
+    return {ns, checksum};
+}
+
+int runMarketBench(int weeks) {
+    // alternate runs so frequency scaling does not favour one side
+    double policyNs = 1e300, hardNs = 1e300;
+    long long policySum = 0, hardSum = 0;
+    for (int rep = 0; rep < 3; ++rep) {
+        auto p = timeMarket(Market{}, weeks);
+        auto h = timeMarket(HardcodedMarket{}, weeks);
+        policyNs = min(policyNs, p.first);
+        hardNs = min(hardNs, h.first);
+        policySum = p.second;
+        hardSum = h.second;
+    }
+    auto mr = timeMarket(BasicMarket<MeanRevertingDrift, LinearLogDemand, GaussianNoise, DefaultEvents>{}, weeks);
+    auto ev = timeMarket(BasicMarket<RandomWalkDrift, LinearLogDemand, NoNoise, NoEvents>{}, weeks);
+
+    cout << fixed << setprecision(2);
+    cout << "realizeDemand, " << weeks * 16LL << " calls per run (best of 3):\n";
+    cout << "  policy Market:     " << policyNs << " ns/call (checksum " << policySum << ")\n";
+    cout << "  hardcoded Market:  " << hardNs << " ns/call (checksum " << hardSum << ")\n";
+    cout << "  mean-reverting:    " << mr.first << " ns/call\n";
+    cout << "  noise-free:        " << ev.first << " ns/call\n";
+    cout << (policySum == hardSum ? "Results identical.\n" : "RESULTS DIFFER.\n");
+    return policySum == hardSum ? 0 : 1;
+}
+
+// ---------- Math Check ----------
+// Portable math against the platform libm, and a digest of played games that
+// should match on every host built with the same AITYCOON_PLATFORM_MATH.
+int64_t ulpDistance(double a, double b) {
+    if (a == b) return 0;
+    if (isnan(a) || isnan(b) || signbit(a) != signbit(b)) return INT64_MAX;
+    int64_t d = (int64_t)doubleBits(a) - (int64_t)doubleBits(b);
+    return d < 0 ? -d : d;
+}
+
+int runMathCheck(int samples, int games) {
+    struct Fn { const char* name; double (*mine)(double); double (*ref)(double); double lo, hi; };
+    const Fn fns[] = {
+        {"log1p", portableLog1p, [](double x) { return log1p(x); }, 0.0, 8000.0},
+        {"log1p", portableLog1p, [](double x) { return log1p(x); }, -0.99, 1.0},
+        {"exp", portableExp, [](double x) { return exp(x); }, -700.0, 700.0},
+        {"exp", portableExp, [](double x) { return exp(x); }, -30.0, 0.0},
+        {"log", portableLog, [](double x) { return log(x); }, 1e-300, 1e300},
+    };
+    FastRng rng(11);
+    vector<double> xs((size_t)samples);
+    bool ok = true;
+    volatile double sink = 0.0;
+    cout << fixed << setprecision(2);
+    for (const Fn& f : fns) {
+        const bool logScale = f.lo > 0.0 && f.hi / f.lo > 1e6;
+        for (double& x : xs) {
+            double u = portableUniform(rng);
+            x = logScale ? portableExp(portableLog(f.lo) + u * (portableLog(f.hi) - portableLog(f.lo))) : f.lo + u * (f.hi - f.lo);
+        }
+        int64_t worst = 0;
+        size_t differ = 0;
+        for (double x : xs) {
+            int64_t d = ulpDistance(f.mine(x), f.ref(x));
+            worst = max(worst, d);
+            differ += d != 0;
+        }
+        auto time = [&](double (*fn)(double)) {
+            auto t0 = chrono::steady_clock::now();
+            double acc = 0.0;
+            for (double x : xs) acc += fn(x);
+            sink = sink + acc;
+            return chrono::duration<double, nano>(chrono::steady_clock::now() - t0).count() / xs.size();
+        };
+        double mineNs = time(f.mine), refNs = time(f.ref);
+        ok = ok && worst <= 2;
+        cout << "  " << setw(5) << f.name << " [" << defaultfloat << setprecision(3) << f.lo << ", " << f.hi << "]"
+             << fixed << setprecision(2)
+             << ": max " << worst << " ulp, " << 100.0 * differ / xs.size() << "% not bit-equal to libm; "
+             << mineNs << " vs " << refNs << " ns/call\n";
+    }
+
+    double acc = 0.0;
+    auto t0 = chrono::steady_clock::now();
+    for (int i = 0; i < samples; ++i) acc += portableNormal(rng, 0.0, 1.0);
+    auto t1 = chrono::steady_clock::now();
+    normal_distribution<double> n(0.0, 1.0);
+    for (int i = 0; i < samples; ++i) acc += n(rng);
+    auto t2 = chrono::steady_clock::now();
+    sink = sink + acc;
+    cout << "  normal: " << chrono::duration<double, nano>(t1 - t0).count() / samples << " vs "
+         << chrono::duration<double, nano>(t2 - t1).count() / samples << " ns/draw (std)\n";
+
+    // FNV-1a over what each game ended with
+    uint64_t digest = 1469598103934665603ULL;
+    auto mix = [&](uint64_t v) {
+        for (int b = 0; b < 8; ++b) digest = (digest ^ ((v >> (8 * b)) & 0xff)) * 1099511628211ULL;
+    };
+    GameConfig cfg;
+    for (int i = 0; i < games; ++i) {
+        GameResult r = playAutoGame((uint64_t)i + 1, cfg);
+        mix(doubleBits(r.finalCash));
+        mix((uint64_t)r.unitsSold);
+        mix((uint64_t)r.weeksPlayed);
+    }
+    cout << "Game digest over " << games << " seeds (" << (AITYCOON_PLATFORM_MATH ? "platform" : "portable")
+         << " math): " << hex << setw(16) << setfill('0') << digest << dec << setfill(' ') << "\n";
+    cout << (ok ? "Portable math within 2 ulp of libm.\n" : "PORTABLE MATH OFF BY MORE THAN 2 ULP.\n");
+    return ok ? 0 : 1;
+}
+
+// ---------- Batch Runs & Bootstrap ----------
+// Per-game results are kept column-wise so summaries and resampling stream
+// through contiguous arrays.
+struct BatchResults {
+    vector<double> profit, bankrupt, unitsSold, finalCash;
+
+    size_t size() const { return profit.size(); }
+    void resize(size_t n) { profit.resize(n); bankrupt.resize(n); unitsSold.resize(n); finalCash.resize(n); }
+};
+
+template<class M>
+BatchResults runBatch(size_t games, const BasicGameConfig<M>& cfg, WorkerPool& pool, uint64_t firstSeed = 1) {
+    BatchResults out;
+    out.resize(games);
+    pool.parallelFor(games, 64, [&](size_t b, size_t e) {
+        SuggestBatch batch;
+        vector<GameResult> results(e - b);
+        playAutoGamesBatched(firstSeed + b, e - b, cfg, batch, results.data());
+        for (size_t i = b; i < e; ++i) {
+            const GameResult& r = results[i - b];
+            out.profit[i] = r.totalProfit;
+            out.bankrupt[i] = r.bankrupt ? 1.0 : 0.0;
+            out.unitsSold[i] = r.unitsSold;
+            out.finalCash[i] = r.finalCash;
+        }
+    });
+    return out;
+}
+
+struct ConfidenceInterval {
+    double estimate, lo, hi;
+};
+
+// Poisson bootstrap of column means: each resample gives every row a
+// Poisson(1) weight, shared by all columns of that row (so paired columns stay
+// paired). Weights come from a counter hash of (row, resample), so any thread
+// can generate any slice; the inner loop runs across resamples and vectorizes.
+// Rows are split into one block per task, each with its own accumulators,
+// which are reduced at the end. Percentile intervals at the given level.
+class PoissonBootstrap {
+public:
+    PoissonBootstrap(int resamples, double level = 0.95, uint32_t seed = 0x5eed)
+        : R(max(2, resamples)), level(level), seed(seed) {}
+
+    vector<ConfidenceInterval> means(const vector<const vector<double>*>& cols, WorkerPool& pool) const {
+        const size_t C = cols.size();
+        const size_t n = C ? cols[0]->size() : 0;
+        const size_t blocks = max<size_t>(1, min<size_t>(n / 4096 + 1, (size_t)pool.size() * 4));
+        const size_t rowsPerBlock = (n + blocks - 1) / blocks;
+        // per block: C weighted sums then the weight total, paddedR() of each
+        const size_t RP = paddedR();
+        vector<double> acc(blocks * (C + 1) * RP, 0.0);
+
+        pool.parallelFor(blocks, 1, [&](size_t bb, size_t be) {
+            for (size_t blk = bb; blk < be; ++blk) {
+                double* a = &acc[blk * (C + 1) * RP];
+                size_t lo = blk * rowsPerBlock, hi = min(n, lo + rowsPerBlock);
+                accumulate(cols, lo, hi, a);
+            }
+        });
+
+        vector<ConfidenceInterval> out(C);
+        vector<double> est((size_t)R);
+        for (size_t c = 0; c < C; ++c) {
+            double plain = 0.0;
+            for (double x : *cols[c]) plain += x;
+            for (int r = 0; r < R; ++r) {
+                double sum = 0.0, w = 0.0;
+                for (size_t blk = 0; blk < blocks; ++blk) {
+                    const double* a = &acc[blk * (C + 1) * RP];
+                    sum += a[c * RP + r];
+                    w += a[C * RP + r];
+                }
+                est[r] = w > 0 ? sum / w : 0.0;
+            }
+            sort(est.begin(), est.end());
+            double tail = (1.0 - level) / 2.0;
+            out[c] = {n ? plain / n : 0.0,
+                      est[(size_t)floor(tail * (R - 1))],
+                      est[(size_t)ceil((1.0 - tail) * (R - 1))]};
+        }
+        return out;
+    }
+
+private:
+    static constexpr size_t kRowTile = 512, kResampleTile = 256;
+    int R;
+    double level;
+    uint32_t seed;
+
+    // Poisson(1) by inverse CDF on a 32-bit uniform: count thresholds passed
+    static inline int32_t poissonWeight(uint32_t u) {
+        return (u > 1580030168u) + (u > 3160060337u) + (u > 3950075421u) + (u > 4213413779u)
+             + (u > 4279248393u) + (u > 4292415279u) + (u > 4294609715u) + (u > 4294923205u);
+    }
+
+    static inline uint32_t mix(uint32_t x) {
+        x ^= x >> 16; x *= 0x7feb352du;
+        x ^= x >> 15; x *= 0x846ca68bu;
+        x ^= x >> 16;
+        return x;
+    }
+
+    // Accumulators are laid out with a stride of paddedR() so every inner loop
+    // has the constant trip count kResampleTile (vectorizes at plain -O2)
+    size_t paddedR() const { return ((size_t)R + kResampleTile - 1) / kResampleTile * kResampleTile; }
+
+    void accumulate(const vector<const vector<double>*>& cols, size_t lo, size_t hi, double* a) const {
+        const size_t C = cols.size(), RP = paddedR();
+        for (size_t r0 = 0; r0 < RP; r0 += kResampleTile) {
+            double* __restrict wsum = a + C * RP + r0;
+            for (size_t i0 = lo; i0 < hi; i0 += kRowTile) {
+                const size_t i1 = min(hi, i0 + kRowTile);
+                for (size_t i = i0; i < i1; ++i) {
+                    const uint32_t rowKey = mix((uint32_t)i * 0x9E3779B9u ^ (uint32_t)(i >> 32) ^ seed);
+                    double w[kResampleTile];
+                    for (size_t r = 0; r < kResampleTile; ++r)
+                        w[r] = poissonWeight(mix(rowKey ^ (uint32_t)(r0 + r) * 0x85EBCA6Bu));
+                    for (size_t r = 0; r < kResampleTile; ++r) wsum[r] += w[r];
+                    for (size_t c = 0; c < C; ++c) {
+                        const double x = (*cols[c])[i];
+                        double* __restrict ac = a + c * RP + r0;
+                        for (size_t r = 0; r < kResampleTile; ++r) ac[r] += w[r] * x;
+                    }
+                }
+            }
+        }
+    }
+};
+
+void printInterval(const char* label, const ConfidenceInterval& ci, double level) {
+    cout << "  " << left << setw(22) << label << right << setw(12) << ci.estimate
+         << "   " << (int)lround(level * 100) << "% CI [" << ci.lo << ", " << ci.hi << "]\n";
+}
+
+int runBatchSummary(int games, int resamples) {
+    WorkerPool pool;
+    GameConfig cfg;
+    auto t0 = chrono::steady_clock::now();
+    BatchResults res = runBatch((size_t)games, cfg, pool);
+    auto t1 = chrono::steady_clock::now();
+    PoissonBootstrap boot(resamples);
+    auto ci = boot.means({&res.profit, &res.bankrupt, &res.unitsSold, &res.finalCash}, pool);
+    auto t2 = chrono::steady_clock::now();
+
+    cout << fixed << setprecision(2);
+    cout << "Batch of " << games << " games (" << chrono::duration<double>(t1 - t0).count() << " s), "
+         << resamples << " bootstrap resamples (" << chrono::duration<double>(t2 - t1).count() << " s)\n";
+    printInterval("Mean profit ($)", ci[0], 0.95);
+    printInterval("Bankruptcy rate (%)", {ci[1].estimate * 100, ci[1].lo * 100, ci[1].hi * 100}, 0.95);
+    printInterval("Avg units sold", ci[2], 0.95);
+    printInterval("Mean final cash ($)", ci[3], 0.95);
+    return 0;
+}
+
+// Same seeds under two advisor learning rates; the bootstrap resamples
+// whole games, so the difference keeps its pairing.
+int runPairedComparison(int games, double lrA, double lrB, int resamples) {
+    WorkerPool pool;
+    GameConfig a, b;
+    a.advisor.learningRate = lrA;
+    b.advisor.learningRate = lrB;
+    BatchResults ra = runBatch((size_t)games, a, pool);
+    BatchResults rb = runBatch((size_t)games, b, pool);
+    vector<double> diff(ra.size());
+    for (size_t i = 0; i < diff.size(); ++i) diff[i] = rb.profit[i] - ra.profit[i];
+
+    PoissonBootstrap boot(resamples);
+    auto ci = boot.means({&ra.profit, &rb.profit, &diff}, pool);
+    cout << fixed << setprecision(2);
+    cout << "Paired comparison over " << games << " seeds, " << resamples << " resamples\n";
+    printInterval(("A: lr=" + to_string(lrA)).c_str(), ci[0], 0.95);
+    printInterval(("B: lr=" + to_string(lrB)).c_str(), ci[1], 0.95);
+    printInterval("B - A profit", ci[2], 0.95);
+    cout << (ci[2].lo > 0 ? "B is better" : ci[2].hi < 0 ? "A is better" : "No significant difference")
+         << " at 95%\n";
+    return 0;
+}
+
+// Resampling throughput on synthetic columns (no games played)
+int runBootstrapBench(long long rows, int resamples) {
+    WorkerPool pool;
+    vector<double> profit((size_t)rows), bankrupt((size_t)rows), units((size_t)rows);
+    FastRng g(7);
+    normal_distribution<double> p(-5000.0, 3000.0), u(450.0, 80.0);
+    for (size_t i = 0; i < profit.size(); ++i) {
+        profit[i] = p(g);
+        bankrupt[i] = profit[i] < -12000.0;
+        units[i] = u(g);
+    }
+    PoissonBootstrap boot(resamples);
+    auto t0 = chrono::steady_clock::now();
+    auto ci = boot.means({&profit, &bankrupt, &units}, pool);
+    double secs = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+    cout << fixed << setprecision(3);
+    cout << rows << " rows x " << resamples << " resamples x 3 columns in " << secs << " s ("
+         << rows * (double)resamples / secs / 1e9 << " G row-resamples/s on " << pool.size() << " threads)\n";
+    printInterval("Mean profit ($)", ci[0], 0.95);
+    printInterval("Bankruptcy rate", ci[1], 0.95);
+    printInterval("Avg units sold", ci[2], 0.95);
+    return 0;
+}
+
+// ---------- Sensitivity Analysis ----------
+// Sobol first-order and total-effect indices of expected profit with respect
+// to market, cost and advisor parameters. Saltelli's scheme evaluates f(A),
+// f(B) and f(AB_i) for every base row; rows come from an R_2d additive
+// recurrence (a low-discrepancy sequence), so a row is generated from its
+// index and no sample matrix is ever stored. All d+2 evaluations of a row
+// share game seeds (common random numbers). Estimators accumulate as running
+// sums: Saltelli (2010) for first order, Jansen for total effect.
+struct SobolParam {
+    const char* name;
+    double lo, hi;
+    void (*apply)(GameConfig&, double);
+};
+
+vector<SobolParam> defaultSobolParams() {
+    return {
+        {"priceSensitivity", 1.0, 1.8, [](GameConfig& c, double v) { c.market.priceSensitivity = v; }},
+        {"adEffect", 6.0, 12.0, [](GameConfig& c, double v) { c.market.adEffect = v; }},
+        {"noiseStd", 2.0, 10.0, [](GameConfig& c, double v) { c.market.noiseStd = v; }},
+        {"demandDrift", -0.5, 0.5, [](GameConfig& c, double v) { c.market.demandDrift = v; }},
+        {"unitCost", 6.0, 10.0, [](GameConfig& c, double v) { c.company.unitCost = v; }},
+        {"fixedCost", 900.0, 1500.0, [](GameConfig& c, double v) { c.company.fixedCost = v; }},
+        {"learningRate", 0.0005, 0.004, [](GameConfig& c, double v) { c.advisor.learningRate = v; }},
+        {"priorBaseline", 20.0, 60.0, [](GameConfig& c, double v) { c.advisor.prior.w0 = v; }},
+    };
+}
+
+// Point j of the R_dims sequence (Roberts 2018), coordinates in [0, 1)
+void additiveRecurrence(uint64_t j, int dims, double* out) {
+    // phi_d is the unique positive root of x^(d+1) = x + 1
+    double phi = 2.0;
+    for (int it = 0; it < 30; ++it) phi = pow(1.0 + phi, 1.0 / (dims + 1));
+    double alpha = 1.0;
+    for (int k = 0; k < dims; ++k) {
+        alpha /= phi;
+        double v = 0.5 + alpha * (double)(j + 1);
+        out[k] = v - floor(v);
+    }
+}
+
+struct SobolSums {
+    uint64_t rows = 0;
+    double sumF = 0.0, sumF2 = 0.0;  // over f(A) and f(B)
+    vector<double> first, total;
+
+    explicit SobolSums(size_t d = 0) : first(d, 0.0), total(d, 0.0) {}
+    void merge(const SobolSums& o) {
+        rows += o.rows; sumF += o.sumF; sumF2 += o.sumF2;
+        for (size_t i = 0; i < first.size(); ++i) { first[i] += o.first[i]; total[i] += o.total[i]; }
+    }
+};
+
+int runSobolAnalysis(int baseRows, int gamesPerPoint) {
+    WorkerPool pool;
+    vector<SobolParam> params = defaultSobolParams();
+    const int d = (int)params.size();
+    const int reps = max(1, gamesPerPoint);
+    SobolSums total(d);
+    mutex m;
+
+    auto evaluate = [&](const double* u, uint64_t row) {
+        GameConfig cfg;
+        for (int k = 0; k < d; ++k) params[k].apply(cfg, params[k].lo + u[k] * (params[k].hi - params[k].lo));
+        double f = 0.0;
+        for (int r = 0; r < reps; ++r) f += playAutoGame(row * reps + r + 1, cfg).totalProfit;
+        return f / reps;
+    };
+
+    auto t0 = chrono::steady_clock::now();
+    pool.parallelFor((size_t)baseRows, 4, [&](size_t b, size_t e) {
+        SobolSums local(d);
+        vector<double> ab(2 * d), mixed(d);
+        for (size_t j = b; j < e; ++j) {
+            additiveRecurrence(j, 2 * d, ab.data()); // first d coordinates are A, the rest B
+            const double* A = ab.data();
+            const double* B = ab.data() + d;
+            double fA = evaluate(A, j), fB = evaluate(B, j);
+            local.rows++;
+            local.sumF += fA + fB;
+            local.sumF2 += fA * fA + fB * fB;
+            for (int i = 0; i < d; ++i) {
+                copy(A, A + d, mixed.begin());
+                mixed[i] = B[i];
+                double fABi = evaluate(mixed.data(), j);
+                local.first[i] += fB * (fABi - fA);
+                local.total[i] += (fA - fABi) * (fA - fABi);
+            }
+        }
+        lock_guard<mutex> lk(m);
+        total.merge(local);
+    });
+    double secs = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+
+    double n = (double)total.rows;
+    double mean = total.sumF / (2 * n);
+    double var = total.sumF2 / (2 * n) - mean * mean;
+    cout << fixed << setprecision(3);
+    cout << "Sobol indices of total profit: " << baseRows << " base rows x " << (d + 2) << " points x "
+         << reps << " games (" << secs << " s)\n";
+    cout << "Mean profit $" << setprecision(2) << mean << ", std $" << sqrt(max(0.0, var)) << "\n" << setprecision(3);
+    cout << "  parameter              first   total\n";
+    for (int i = 0; i < d; ++i)
+        cout << "  " << left << setw(20) << params[i].name << right
+             << setw(8) << (var > 0 ? total.first[i] / n / var : 0.0)
+             << setw(8) << (var > 0 ? total.total[i] / (2 * n) / var : 0.0) << "\n";
+    return 0;
+}
+
+// ---------- SKU Catalog ----------
+// Hierarchical pooling of advisor weights across a catalog. Each SKU's weight
+// vector has a Gaussian prior centred on its (category, region) cell; the cell
+// mean is itself shrunk toward the category and region means, which are
+// shrunk toward the catalog mean. Per-SKU evidence is kept as Gaussian natural
+// parameters (X'y and X'X over the SKU's sales, packed into SoA columns), so an
+// observation is a conjugate rank-one add and the posterior is simply
+// prior + data: re-estimating the priors never double counts sales.
+// rebalance() re-estimates every level with one EM pass, linear in SKUs.
+constexpr int kAdvisorFeatures = 5;
+constexpr int kAdvisorPairs = kAdvisorFeatures * (kAdvisorFeatures + 1) / 2;
+
+// Advisor feature vector (same layout as AdvisorWeights)
+inline void advisorFeatures(double price, double ad, double baseProxy, int inventoryAvail,
+                            double eventAdMult, double eventPriceMult, double x[kAdvisorFeatures]) {
+    x[0] = 1.0;
+    x[1] = - price * (1.0 + eventPriceMult);
+    x[2] = simLog1p(ad) * (1.0 + eventAdMult);
+    x[3] = baseProxy;
+    x[4] = (double)inventoryAvail;
+}
+
+inline AdvisorWeights weightsFrom(const double w[kAdvisorFeatures]) { return {w[0], w[1], w[2], w[3], w[4]}; }
+
+class SkuCatalog {
+public:
+    SkuCatalog(int categories, int regions, const AdvisorConfig& cfg = AdvisorConfig(), double obsNoise = 6.0)
+        : categories(categories), regions(regions), noisePrec(1.0 / (obsNoise * obsNoise))
+    {
+        const double p[kAdvisorFeatures] = {cfg.prior.w0, cfg.prior.wP, cfg.prior.wA, cfg.prior.wB, cfg.prior.wI};
+        const double spread[kAdvisorFeatures] = {400.0, 1.0, 25.0, 0.25, 0.01};
+        for (int k = 0; k < kAdvisorFeatures; ++k) {
+            rootMean[k] = p[k];
+            rootVar[k] = spread[k];
+            cellMean[k].assign(categories * regions, p[k]);
+            cellVar[k].assign(categories * regions, spread[k]);
+        }
+    }
+
+    int add(int category, int region) {
+        int cell = category * regions + region;
+        cellOf.push_back(cell);
+        for (int k = 0; k < kAdvisorFeatures; ++k) {
+            xy[k].push_back(0.0);
+            priorMean[k].push_back(cellMean[k][cell]);
+            priorPrec[k].push_back(1.0 / cellVar[k][cell]);
+        }
+        for (int q = 0; q < kAdvisorPairs; ++q) xx[q].push_back(0.0);
+        return (int)cellOf.size() - 1;
+    }
+
+    size_t size() const { return cellOf.size(); }
+
+    // Posterior mean and marginal variances: Cholesky of the 5x5 precision
+    void posterior(size_t s, double mean[kAdvisorFeatures], double var[kAdvisorFeatures]) const {
+        const int K = kAdvisorFeatures;
+        double L[K][K] = {}, b[K];
+        for (int i = 0, q = 0; i < K; ++i) {
+            for (int j = i; j < K; ++j, ++q) L[j][i] = noisePrec * xx[q][s];
+            L[i][i] += priorPrec[i][s];
+            b[i] = noisePrec * xy[i][s] + priorPrec[i][s] * priorMean[i][s];
+        }
+        for (int j = 0; j < K; ++j) {
+            for (int k = 0; k < j; ++k) L[j][j] -= L[j][k] * L[j][k];
+            L[j][j] = sqrt(L[j][j]);
+            for (int i = j + 1; i < K; ++i) {
+                for (int k = 0; k < j; ++k) L[i][j] -= L[i][k] * L[j][k];
+                L[i][j] /= L[j][j];
+            }
+        }
+        double z[K];
+        for (int i = 0; i < K; ++i) {
+            z[i] = b[i];
+            for (int k = 0; k < i; ++k) z[i] -= L[i][k] * z[k];
+            z[i] /= L[i][i];
+        }
+        for (int i = K - 1; i >= 0; --i) {
+            mean[i] = z[i];
+            for (int k = i + 1; k < K; ++k) mean[i] -= L[k][i] * mean[k];
+            mean[i] /= L[i][i];
+        }
+        if (!var) return;
+        // diag(P^-1) = column sums of squares of L^-1
+        double inv[K][K] = {};
+        for (int c = 0; c < K; ++c) {
+            for (int i = c; i < K; ++i) {
+                double v = (i == c) ? 1.0 : 0.0;
+                for (int k = c; k < i; ++k) v -= L[i][k] * inv[k][c];
+                inv[i][c] = v / L[i][i];
+            }
+        }
+        for (int k = 0; k < K; ++k) {
+            var[k] = 0.0;
+            for (int i = k; i < K; ++i) var[k] += inv[i][k] * inv[i][k];
+        }
+    }
+
+    AdvisorWeights weights(size_t s) const {
+        double m[kAdvisorFeatures];
+        posterior(s, m, nullptr);
+        return weightsFrom(m);
+    }
+
+    Plan suggest(size_t s, const Company& c, double baseProxy, double eventAdMult, double eventPriceMult) const {
+        return AIAdvisor::suggestFor(weights(s), c.inventory, c.unitCost, c.fixedCost, baseProxy, eventAdMult, eventPriceMult);
+    }
+
+    // Conjugate update: rank-one add to the SKU's evidence
+    void observe(size_t s, const double x[kAdvisorFeatures], double sold) {
+        for (int i = 0, q = 0; i < kAdvisorFeatures; ++i) {
+            xy[i][s] += x[i] * sold;
+            for (int j = i; j < kAdvisorFeatures; ++j, ++q) xx[q][s] += x[i] * x[j];
+        }
+    }
+
+    // One EM pass: posterior moments per SKU, group sums, new cell priors
+    void rebalance() {
+        const size_t n = size();
+        const int cells = categories * regions;
+        const double pseudo = 2.0; // weight, in SKUs, of each parent level
+        vector<double> cellN(cells, 0.0);
+        for (size_t s = 0; s < n; ++s) cellN[cellOf[s]] += 1.0;
+        vector<double> catN(categories, 0.0), regN(regions, 0.0);
+        for (int c = 0; c < cells; ++c) { catN[c / regions] += cellN[c]; regN[c % regions] += cellN[c]; }
+
+        vector<double> cellSum[kAdvisorFeatures], cellSq[kAdvisorFeatures];
+        for (int k = 0; k < kAdvisorFeatures; ++k) { cellSum[k].assign(cells, 0.0); cellSq[k].assign(cells, 0.0); }
+        for (size_t s = 0; s < n; ++s) {
+            double m[kAdvisorFeatures], v[kAdvisorFeatures];
+            posterior(s, m, v);
+            for (int k = 0; k < kAdvisorFeatures; ++k) {
+                cellSum[k][cellOf[s]] += m[k];
+                cellSq[k][cellOf[s]] += m[k] * m[k] + v[k]; // E[theta^2]
+            }
+        }
+
+        for (int k = 0; k < kAdvisorFeatures; ++k) {
+            vector<double> catSum(categories, 0.0), regSum(regions, 0.0);
+            double total = 0.0, totalSq = 0.0;
+            for (int c = 0; c < cells; ++c) {
+                catSum[c / regions] += cellSum[k][c];
+                regSum[c % regions] += cellSum[k][c];
+                total += cellSum[k][c];
+                totalSq += cellSq[k][c];
+            }
+            double globalMean = (total + pseudo * rootMean[k]) / (n + pseudo);
+            double globalVar = (totalSq - 2.0 * globalMean * total + n * globalMean * globalMean
+                                + pseudo * rootVar[k]) / (n + pseudo);
+            for (int c = 0; c < cells; ++c) {
+                int cat = c / regions, reg = c % regions;
+                double catMean = (catSum[cat] + pseudo * globalMean) / (catN[cat] + pseudo);
+                double regMean = (regSum[reg] + pseudo * globalMean) / (regN[reg] + pseudo);
+                double mu = (cellSum[k][c] + pseudo * 0.5 * (catMean + regMean)) / (cellN[c] + pseudo);
+                // EM variance: E[(theta - mu)^2] over the cell's SKUs
+                double ss = cellSq[k][c] - 2.0 * mu * cellSum[k][c] + cellN[c] * mu * mu;
+                cellMean[k][c] = mu;
+                cellVar[k][c] = max(rootVar[k] * 1e-4, (ss + pseudo * globalVar) / (cellN[c] + pseudo));
+            }
+
+            // Gather the new cell priors into the per-SKU columns
+            const double* cm = cellMean[k].data();
+            const double* cv = cellVar[k].data();
+            double* __restrict pm = priorMean[k].data();
+            double* __restrict pp = priorPrec[k].data();
+            for (size_t s = 0; s < n; ++s) {
+                pm[s] = cm[cellOf[s]];
+                pp[s] = 1.0 / cv[cellOf[s]];
+            }
+        }
+    }
+
+private:
+    int categories, regions;
+    double noisePrec;
+    double rootMean[kAdvisorFeatures], rootVar[kAdvisorFeatures];
+    vector<int> cellOf;
+    vector<double> xy[kAdvisorFeatures], xx[kAdvisorPairs];                 // data evidence
+    vector<double> priorMean[kAdvisorFeatures], priorPrec[kAdvisorFeatures]; // cell prior per SKU
+    vector<double> cellMean[kAdvisorFeatures], cellVar[kAdvisorFeatures];
+};
+
+// Synthetic catalog: true weights are global + category + region effects plus
+// a small per-SKU part. Each week every SKU sells with some probability under
+// a random plan. Demand predictions of the pooled catalog are compared with
+// one independent AIAdvisor per SKU, bucketed by how much the SKU has seen;
+// new SKUs arrive halfway through.
+int runCatalogBench(int skus, int weeks) {
+    const int categories = 8, regions = 6;
+    const double sellProb = 0.15, noise = 6.0;
+    Rng rng(2024);
+    normal_distribution<double> g(0.0, 1.0);
+    uniform_real_distribution<double> u(0.0, 1.0);
+
+    double catW0[categories], catP[categories], regW0[regions], regA[regions];
+    for (int c = 0; c < categories; ++c) { catW0[c] = 8.0 * g(rng); catP[c] = 1.0 + 0.3 * g(rng); }
+    for (int r = 0; r < regions; ++r) { regW0[r] = 5.0 * g(rng); regA[r] = 1.0 + 0.2 * g(rng); }
+
+    struct Truth { double w[kAdvisorFeatures]; double base; int seen; };
+    vector<Truth> truth;
+    vector<AIAdvisor> independent;
+    SkuCatalog catalog(categories, regions);
+    auto addSku = [&]() {
+        int c = (int)(u(rng) * categories), r = (int)(u(rng) * regions);
+        Truth t;
+        t.w[0] = 10.0 + catW0[c] + regW0[r] + 2.0 * g(rng);
+        t.w[1] = 1.4 * catP[c] + 0.05 * g(rng);
+        t.w[2] = 9.0 * regA[r] + 0.3 * g(rng);
+        t.w[3] = 0.6;
+        t.w[4] = 0.08;
+        t.base = 30.0 + 60.0 * u(rng);
+        t.seen = 0;
+        truth.push_back(t);
+        independent.emplace_back();
+        catalog.add(c, r);
+    };
+    for (int i = 0; i < skus; ++i) addSku();
+
+    auto dot = [](const double* w, const double* x) {
+        double y = 0.0;
+        for (int k = 0; k < kAdvisorFeatures; ++k) y += w[k] * x[k];
+        return y;
+    };
+    // Expected profit of a plan under the SKU's true demand
+    auto trueProfit = [&](const Truth& t, const Plan& p) {
+        Company co;
+        double x[kAdvisorFeatures];
+        advisorFeatures(p.price, p.adSpend, t.base, co.inventory + p.production, 0.0, 0.0, x);
+        int sold = min((int)round(max(0.0, dot(t.w, x))), co.inventory + p.production);
+        return sold * p.price - p.production * co.unitCost - p.adSpend - co.fixedCost;
+    };
+
+    const int buckets = 4;
+    const char* bucketName[buckets] = {"0 obs", "1-3 obs", "4-10 obs", "11+ obs"};
+    double sqPooled[buckets] = {}, sqIndep[buckets] = {}, count[buckets] = {};
+    double newPooledProfit = 0.0, newIndepProfit = 0.0, newOracleProfit = 0.0;
+    int newSkus = 0;
+    double rebalanceSecs = 0.0;
+
+    for (int week = 0; week < weeks; ++week) {
+        if (week == weeks / 2) {
+            int first = (int)truth.size();
+            for (int i = 0; i < skus / 4; ++i) addSku();
+            // Advice for brand-new SKUs before any of their own sales
+            Company co;
+            for (int s = first; s < (int)truth.size(); ++s) {
+                newPooledProfit += trueProfit(truth[s], catalog.suggest(s, co, truth[s].base, 0.0, 0.0));
+                newIndepProfit += trueProfit(truth[s], independent[s].suggest(co, truth[s].base, 0.0, 0.0));
+                newOracleProfit += trueProfit(truth[s], AIAdvisor::suggestFor(weightsFrom(truth[s].w), co.inventory,
+                                                 co.unitCost, co.fixedCost, truth[s].base, 0.0, 0.0));
+                ++newSkus;
+            }
+        }
+        for (int s = 0; s < (int)truth.size(); ++s) {
+            if (u(rng) >= sellProb) continue;
+            Truth& t = truth[s];
+            MarketEvent ev = drawEvent(week, rng);
+            double price = 12.0 + 23.0 * u(rng), ad = 500.0 * (int)(u(rng) * 17);
+            int avail = 150 + (int)(u(rng) * 100);
+            double x[kAdvisorFeatures];
+            advisorFeatures(price, ad, t.base, avail, ev.adShock, ev.priceShock, x);
+            double sold = min((double)avail, max(0.0, round(dot(t.w, x) + noise * g(rng))));
+
+            int b = t.seen == 0 ? 0 : t.seen <= 3 ? 1 : t.seen <= 10 ? 2 : 3;
+            double mp[kAdvisorFeatures], vp[kAdvisorFeatures];
+            catalog.posterior(s, mp, vp);
+            AdvisorWeights wi = independent[s].weights();
+            double wiv[kAdvisorFeatures] = {wi.w0, wi.wP, wi.wA, wi.wB, wi.wI};
+            double ePooled = max(0.0, dot(mp, x)) - sold, eIndep = max(0.0, dot(wiv, x)) - sold;
+            sqPooled[b] += ePooled * ePooled;
+            sqIndep[b] += eIndep * eIndep;
+            count[b] += 1.0;
+
+            catalog.observe(s, x, sold);
+            independent[s].learn(price, ad, t.base, avail, (int)sold, ev.adShock, ev.priceShock);
+            t.seen++;
+        }
+        auto t0 = chrono::steady_clock::now();
+        catalog.rebalance();
+        rebalanceSecs += chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+    }
+
+    cout << fixed << setprecision(2);
+    cout << "Catalog: " << truth.size() << " SKUs, " << categories << " categories x " << regions
+         << " regions, " << weeks << " weeks\n";
+    cout << "Demand RMSE      pooled  independent  (observations)\n";
+    for (int b = 0; b < buckets; ++b)
+        if (count[b] > 0)
+            cout << "  " << left << setw(12) << bucketName[b] << right << setw(9) << sqrt(sqPooled[b] / count[b])
+                 << setw(13) << sqrt(sqIndep[b] / count[b]) << "  (" << (long long)count[b] << ")\n";
+    if (newSkus > 0)
+        cout << "New-SKU advice, expected profit: pooled $" << newPooledProfit / newSkus
+             << ", independent $" << newIndepProfit / newSkus << ", oracle $" << newOracleProfit / newSkus << "\n";
+    cout << "Rebalance: " << setprecision(1) << rebalanceSecs / weeks / truth.size() * 1e9 << " ns per SKU\n";
+    return 0;
+}
+
+// ---------- Optimal Policy ----------
+// Offline yardstick for advisors: backward induction over a discretized
+// (week, cash, inventory, baseline) grid under the true market dynamics. The
+// policy sees the hidden baseline, so its profit bounds what any advisor
+// working from the public proxy can reach. Drift and demand noise use 3-point
+// Gauss-Hermite rules and sales are continuous inside the solver. Values are
+// expected profit over the remaining weeks (zero once bankrupt), interpolated
+// in cash, inventory and baseline. Backups search a coarser action lattice
+// (16 prices x 9 ad levels x 7 production levels) kept as SoA tables per
+// event and run in parallel across states; decide() then acts greedily on the
+// advisor's full grid, which recovers most of what the lattice gives up.
+class OptimalPolicy {
+public:
+    static constexpr int kCash = 12, kInv = 21, kBase = 16;
+    static constexpr double kCashLo = -5000.0, kCashStep = 5000.0; // bottom row is the bankruptcy line
+    static constexpr double kInvStep = 10.0, kBaseLo = 45.0, kBaseStep = 2.0;
+
+    explicit OptimalPolicy(const GameConfig& cfg) : cfg(cfg), V(cfg.weeks + 1) {
+        const Market& mk = cfg.market;
+        const MarketEvent quiet = kEventTable[kEventKinds - 1].ev;
+        // LinearLogDemand is additive in its arguments; probe each term once
+        availCoef = mk.meanDemand(0.0, 0.0, 0.0, quiet, 1) - mk.meanDemand(0.0, 0.0, 0.0, quiet, 0);
+        for (double price = 9.0; price <= 40.0; price += 2.0)
+            for (double ad = 0.0; ad <= 8000.0; ad += 1000.0)
+                for (int prod = 0; prod <= 120; prod += 20) {
+                    actPrice.push_back(price);
+                    actProd.push_back(prod);
+                    actCost.push_back(prod * cfg.company.unitCost + ad + cfg.company.fixedCost);
+                }
+        for (int e = 0; e < kEventKinds; ++e) {
+            const MarketEvent& ev = kEventTable[e].ev;
+            evProb[e] = kEventTable[e].upTo - (e ? kEventTable[e - 1].upTo : 0.0);
+            evConst[e] = mk.meanDemand(0.0, 0.0, 0.0, ev, 0);
+            for (double price = 9.0; price <= 40.0; price += 2.0)
+                for (double ad = 0.0; ad <= 8000.0; ad += 1000.0)
+                    for (int prod = 0; prod <= 120; prod += 20)
+                        actMu[e].push_back(mk.meanDemand(0.0, price, 0.0, ev, 0) + mk.meanDemand(0.0, 0.0, ad, ev, 0)
+                                           - 2.0 * evConst[e] + availCoef * prod);
+        }
+        for (auto& v : V) v.assign((size_t)kBase * kInv * kCash, 0.0);
+    }
+
+    void solve(WorkerPool& pool) {
+        const size_t states = (size_t)kBase * kInv * kCash;
+        vector<double> U(states);
+        for (int w = cfg.weeks; w >= 1; --w) {
+            // U: value of entering week w's decision at each grid state
+            pool.parallelFor(states, 16, [&](size_t b, size_t e) {
+                for (size_t s = b; s < e; ++s) {
+                    int c = (int)(s % kCash), i = (int)(s / kCash % kInv), bi = (int)(s / kCash / kInv);
+                    U[s] = backup(w, kCashLo + c * kCashStep, i * kInvStep, kBaseLo + bi * kBaseStep,
+                                  V[w].data() + (size_t)bi * kInv * kCash);
+                }
+            });
+            // V[w-1]: expectation over the drift that opens week w
+            const double z[3] = {-sqrt(3.0), 0.0, sqrt(3.0)}, q[3] = {1.0 / 6, 2.0 / 3, 1.0 / 6};
+            for (size_t s = 0; s < states; ++s) {
+                int c = (int)(s % kCash), i = (int)(s / kCash % kInv), bi = (int)(s / kCash / kInv);
+                double v = 0.0;
+                for (int n = 0; n < 3; ++n) {
+                    double next = max(5.0, kBaseLo + bi * kBaseStep + cfg.market.demandDrift + cfg.market.driftStd * z[n]);
+                    v += q[n] * lerpBase(U.data(), c, i, next);
+                }
+                V[w - 1][s] = v;
+            }
+        }
+    }
+
+    // Expected profit over weeks after `week`, given the state once it resolved
+    double value(int week, double cash, double inventory, double baseline) const {
+        if (week >= cfg.weeks || cash < kCashLo) return 0.0;
+        double fb = clampv((baseline - kBaseLo) / kBaseStep, 0.0, kBase - 1.0);
+        int b0 = min((int)fb, kBase - 2);
+        double tb = fb - b0;
+        const double* Vw = V[week].data();
+        return (1.0 - tb) * bilinear(Vw + (size_t)b0 * kInv * kCash, cash, inventory)
+               + tb * bilinear(Vw + (size_t)(b0 + 1) * kInv * kCash, cash, inventory);
+    }
+
+    // Greedy plan against the solved values, over the advisor's full grid
+    Plan decide(int week, double cash, int inventory, double baseline, const MarketEvent& ev) const {
+        const double z[3] = {-sqrt(3.0), 0.0, sqrt(3.0)}, q[3] = {1.0 / 6, 2.0 / 3, 1.0 / 6};
+        const double sd = cfg.market.noiseStd;
+        double bestQ = -1e300;
+        Plan best{20, 1000, 50};
+        for (double price = 9.0; price <= 40.0; price += 1.0)
+            for (double ad = 0.0; ad <= 8000.0; ad += 500.0)
+                for (int prod = 0; prod <= 120; prod += 10) {
+                    int avail = inventory + prod;
+                    double mu = cfg.market.meanDemand(baseline, price, ad, ev, avail);
+                    double cost = prod * cfg.company.unitCost + ad + cfg.company.fixedCost, qa = 0.0;
+                    for (int n = 0; n < 3; ++n) {
+                        double sold = min(max(0.0, mu + sd * z[n]), (double)avail);
+                        double profit = sold * price - cost;
+                        qa += q[n] * (profit + value(week, cash + profit, avail - sold, baseline));
+                    }
+                    if (qa > bestQ) { bestQ = qa; best = {price, ad, prod}; }
+                }
+        return best;
+    }
+
+private:
+    GameConfig cfg;
+    vector<vector<double>> V; // V[w]: [baseline][inventory][cash] after week w
+    double availCoef = 0.0;
+    double evProb[kEventKinds], evConst[kEventKinds];
+    vector<double> actPrice, actCost, actMu[kEventKinds];
+    vector<int> actProd;
+
+    static double bilinear(const double* Vb, double cash, double inventory) {
+        double fc = clampv((cash - kCashLo) / kCashStep, 0.0, kCash - 1.0);
+        double fi = clampv(inventory / kInvStep, 0.0, kInv - 1.0);
+        int c0 = min((int)fc, kCash - 2), i0 = min((int)fi, kInv - 2);
+        double tc = fc - c0, ti = fi - i0;
+        const double* r0 = Vb + (size_t)i0 * kCash + c0;
+        const double* r1 = r0 + kCash;
+        return (1.0 - ti) * ((1.0 - tc) * r0[0] + tc * r0[1]) + ti * ((1.0 - tc) * r1[0] + tc * r1[1]);
+    }
+
+    static double lerpBase(const double* U, int c, int i, double baseline) {
+        double fb = clampv((baseline - kBaseLo) / kBaseStep, 0.0, kBase - 1.0);
+        int b0 = min((int)fb, kBase - 2);
+        double tb = fb - b0;
+        size_t at = ((size_t)b0 * kInv + i) * kCash + c;
+        return (1.0 - tb) * U[at] + tb * U[at + (size_t)kInv * kCash];
+    }
+
+    // Event-averaged best action value at one grid state; Vb is V[w] at this baseline
+    double backup(int w, double cash, double inventory, double baseline, const double* Vb) const {
+        const double z[3] = {-sqrt(3.0), 0.0, sqrt(3.0)}, q[3] = {1.0 / 6, 2.0 / 3, 1.0 / 6};
+        const double sd = cfg.market.noiseStd;
+        const bool last = (w == cfg.weeks);
+        const size_t actions = actPrice.size();
+        double total = 0.0;
+        for (int e = 0; e < kEventKinds; ++e) {
+            double mu0 = baseline + evConst[e] + availCoef * inventory;
+            const double* mu = actMu[e].data();
+            double best = -1e300;
+            for (size_t a = 0; a < actions; ++a) {
+                double avail = inventory + actProd[a], qa = 0.0;
+                for (int n = 0; n < 3; ++n) {
+                    double sold = min(max(0.0, mu0 + mu[a] + sd * z[n]), avail);
+                    double profit = sold * actPrice[a] - actCost[a];
+                    double cashAfter = cash + profit;
+                    double cont = (last || cashAfter < kCashLo) ? 0.0 : bilinear(Vb, cashAfter, avail - sold);
+                    qa += q[n] * (profit + cont);
+                }
+                best = max(best, qa);
+            }
+            total += evProb[e] * best;
+        }
+        return total;
+    }
+};
+
+// Solved policy playing the real game (same random stream as playAutoGame)
+GameResult playOptimalGame(uint64_t seed, const OptimalPolicy& policy, const GameConfig& cfg) {
+    Game game(seed, cfg);
+    GameResult res;
+    res.seed = seed;
+    for (int w = 1; w <= cfg.weeks; ++w) {
+        MarketEvent ev = game.beginWeek();
+        Plan p = policy.decide(w, game.co.cash, game.co.inventory, game.mk.baseDemand, ev);
+        const Snapshot& snap = game.resolveWeek(p, ev);
+        res.weeksPlayed = w;
+        res.unitsSold += snap.sold;
+        res.totalProfit += snap.profit;
+        if (game.bankrupt()) { res.bankrupt = true; break; }
+    }
+    res.finalCash = game.co.cash;
+    return res;
+}
+
+int runOptimalPolicy(int games) {
+    GameConfig cfg;
+    WorkerPool pool;
+    OptimalPolicy policy(cfg);
+    auto t0 = chrono::steady_clock::now();
+    policy.solve(pool);
+    double solveSecs = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+
+    vector<double> optimal(games);
+    pool.parallelFor(games, 8, [&](size_t b, size_t e) {
+        for (size_t i = b; i < e; ++i) optimal[i] = playOptimalGame(1 + i, policy, cfg).totalProfit;
+    });
+    BatchResults ai = runBatch(games, cfg, pool);
+    double optMean = accumulate(optimal.begin(), optimal.end(), 0.0) / games;
+    double aiMean = accumulate(ai.profit.begin(), ai.profit.end(), 0.0) / games;
+
+    cout << fixed << setprecision(2);
+    cout << "Optimal policy: " << cfg.weeks << " weeks, " << OptimalPolicy::kCash << "x" << OptimalPolicy::kInv
+         << "x" << OptimalPolicy::kBase << " states per week, solved in " << solveSecs << " s\n";
+    cout << "  solver value at start      $" << policy.value(0, cfg.company.cash, cfg.company.inventory, cfg.market.baseDemand) << "\n";
+    cout << "  optimal policy, " << games << " games  $" << optMean << " mean profit\n";
+    cout << "  AI advisor, same seeds     $" << aiMean << " mean profit (gap $" << optMean - aiMean << ")\n";
+    return 0;
+}
+
+// ---------- MCTS Advisor ----------
+// Plans a few weeks ahead with open-loop Monte Carlo tree search over a small
+// lattice of plans plus the linear advisor's pick and its neighbours (which
+// also serve as the rollout policy). The learned demand
+// model is the simulator: future events are drawn from kEventTable and demand
+// noise is Gaussian around the model's prediction. Root parallelism: every
+// pool thread grows its own tree in its own node pool until the time budget
+// runs out, and root visit counts are summed to choose the plan.
+struct MctsConfig {
+    int horizon = 3;              // weeks searched ahead (capped by weeks left), at most 64
+    double budgetMs = 30.0;       // wall time per suggestion
+    double exploration = 1.2;     // UCT constant on [0,1]-scaled returns
+    double noiseStd = 6.0;        // demand noise assumed around the model
+    double salvage = 0.8;         // value of leftover units per unit cost, if weeks remain
+    size_t maxNodes = 1 << 17;    // per tree
+};
+
+class MctsAdvisor {
+public:
+    explicit MctsAdvisor(WorkerPool& pool, const MctsConfig& cfg = MctsConfig())
+        : pool(pool), cfg(cfg), trees(pool.size())
+    {
+        if (cfg.horizon > kMaxHorizon) throw runtime_error("MctsAdvisor: horizon above " + to_string(kMaxHorizon));
+        const double prices[] = {14, 18, 22, 26, 30, 35, 40};
+        const double ads[] = {0, 1500, 4000};
+        const int prods[] = {0, 30, 60, 90, 120};
+        for (double p : prices)
+            for (double a : ads)
+                for (int q : prods) actions.push_back({p, a, q});
+        latticeSize = actions.size();
+        actions.resize(latticeSize + kLocal); // the linear advisor's plan and its neighbours, set per call
+        for (Tree& t : trees) t.nodes.reserve(cfg.maxNodes);
+    }
+
+    uint64_t totalRollouts() const { return rollouts; }
+
+    Plan suggest(const AdvisorWeights& w, const Company& c, double baseProxy, const MarketEvent& ev, int weeksLeft) {
+        Plan g = AIAdvisor::suggestFor(w, c.inventory, c.unitCost, c.fixedCost, baseProxy, ev.adShock, ev.priceShock);
+        size_t at = latticeSize;
+        actions[at++] = g;
+        for (int dp = -2; dp <= 2; ++dp)
+            for (int dq = -10; dq <= 10; dq += 10)
+                if (dp || dq) actions[at++] = {clampv(g.price + dp, 9.0, 40.0), g.adSpend, clampv(g.production + dq, 0, 120)};
+        actions[at++] = {g.price, clampv(g.adSpend - 500.0, 0.0, 8000.0), g.production};
+        actions[at++] = {g.price, clampv(g.adSpend + 500.0, 0.0, 8000.0), g.production};
+        const size_t K = actions.size();
+        // Model demand less the inventory term, per action, for each event kind and this week's event
+        for (int e = 0; e <= kEventKinds; ++e) {
+            const MarketEvent& x = e < kEventKinds ? kEventTable[e].ev : ev;
+            term[e].resize(K);
+            for (size_t a = 0; a < K; ++a)
+                term[e][a] = w.w0 + w.wP * (- actions[a].price * (1.0 + x.priceShock))
+                             + w.wA * simLog1p(actions[a].adSpend) * (1.0 + x.adShock) + w.wB * baseProxy;
+        }
+        wI = w.wI;
+
+        Search s{c.inventory, c.cash, c.unitCost, c.fixedCost, max(1, min(cfg.horizon, weeksLeft)), weeksLeft};
+        auto deadline = chrono::steady_clock::now() + chrono::microseconds((long long)(cfg.budgetMs * 1000));
+        ++calls;
+        pool.parallelFor(trees.size(), 1, [&](size_t b, size_t e) {
+            for (size_t t = b; t < e; ++t) grow(trees[t], s, deadline, calls * 7919 + t);
+        });
+
+        vector<uint64_t> visits(K, 0);
+        vector<double> totals(K, 0.0);
+        for (Tree& t : trees) {
+            rollouts += t.nodes[0].visits;
+            if (!t.nodes[0].firstChild) continue;
+            for (size_t a = 0; a < K; ++a) {
+                visits[a] += t.nodes[t.nodes[0].firstChild + a].visits;
+                totals[a] += t.nodes[t.nodes[0].firstChild + a].total;
+            }
+        }
+        size_t best = latticeSize;
+        for (size_t a = 0; a < K; ++a)
+            if (visits[a] > visits[best] || (visits[a] == visits[best] && visits[a] > 0
+                                             && totals[a] / visits[a] > totals[best] / visits[best])) best = a;
+        return actions[best];
+    }
+
+    template<class M>
+    Plan suggest(const BasicGame<M>& g, const MarketEvent& ev, int weeks) {
+        return suggest(g.ai.weights(), g.co, g.baseProxy, ev, weeks - g.week + 1);
+    }
+
+private:
+    // Children of a node are allocated together: firstChild + action index
+    struct Node {
+        uint32_t firstChild = 0; // 0 = not expanded (the root sits at 0)
+        uint32_t visits = 0;
+        double total = 0.0;
+    };
+    struct Tree {
+        vector<Node> nodes;
+        double lo = 0.0, hi = 0.0; // range of returns seen, for UCT scaling
+    };
+    struct Search {
+        int inventory;
+        double cash, unitCost, fixedCost;
+        int depth, weeksLeft;
+    };
+
+    static constexpr size_t kLocal = 17;
+    static constexpr int kMaxHorizon = 64; // tree depth, sizes the per-iteration path
+
+    WorkerPool& pool;
+    MctsConfig cfg;
+    vector<Tree> trees;
+    vector<Plan> actions;
+    size_t latticeSize = 0;
+    vector<double> term[kEventKinds + 1];
+    double wI = 0.0;
+    uint64_t calls = 0, rollouts = 0;
+
+    double step(int eventSlot, size_t a, int& inventory, FastRng& rng) const {
+        const Plan& p = actions[a];
+        int avail = inventory + p.production;
+        double demand = max(0.0, term[eventSlot][a] + wI * avail + simNormal(rng, 0.0, cfg.noiseStd));
+        int sold = min((int)floor(demand + 0.5), avail);
+        inventory = avail - sold;
+        return sold * p.price; // revenue; the caller books costs
+    }
+
+    int sampleEvent(FastRng& rng) const {
+        double r = simUniform(rng);
+        for (int e = 0; e < kEventKinds; ++e)
+            if (r < kEventTable[e].upTo) return e;
+        return kEventKinds - 1;
+    }
+
+    void grow(Tree& t, const Search& s, chrono::steady_clock::time_point deadline, uint64_t seed) const {
+        FastRng rng(seed);
+        const uint32_t K = (uint32_t)actions.size();
+        t.nodes.clear();
+        t.nodes.emplace_back();
+        t.lo = t.hi = 0.0;
+        uint32_t path[kMaxHorizon];
+        for (uint64_t it = 0;; ++it) {
+            if ((it & 31) == 0 && chrono::steady_clock::now() >= deadline) break;
+            int inventory = s.inventory;
+            double ret = 0.0;
+            int len = 0;
+            uint32_t node = 0;
+            bool inTree = true;
+            size_t fallback = latticeSize; // rollout policy: the linear advisor's plan
+            for (int d = 0; d < s.depth; ++d) {
+                int slot = d == 0 ? kEventKinds : sampleEvent(rng);
+                size_t a = fallback;
+                if (inTree) {
+                    if (!t.nodes[node].firstChild) {
+                        if (t.nodes.size() + K > cfg.maxNodes) inTree = false;
+                        else {
+                            t.nodes[node].firstChild = (uint32_t)t.nodes.size();
+                            t.nodes.resize(t.nodes.size() + K);
+                        }
+                    }
+                    if (inTree) {
+                        a = select(t, t.nodes[node]);
+                        node = t.nodes[node].firstChild + (uint32_t)a;
+                        path[len++] = node;
+                        if (t.nodes[node].visits == 0) inTree = false; // new leaf: roll out the rest
+                    }
+                }
+                const Plan& p = actions[a];
+                ret += step(slot, a, inventory, rng) - (p.production * s.unitCost + p.adSpend + s.fixedCost);
+            }
+            if (s.depth < s.weeksLeft) ret += inventory * s.unitCost * cfg.salvage;
+
+            if (t.nodes[0].visits == 0) t.lo = t.hi = ret;
+            t.lo = min(t.lo, ret);
+            t.hi = max(t.hi, ret);
+            t.nodes[0].visits++;
+            t.nodes[0].total += ret;
+            for (int i = 0; i < len; ++i) {
+                t.nodes[path[i]].visits++;
+                t.nodes[path[i]].total += ret;
+            }
+        }
+    }
+
+    size_t select(const Tree& t, const Node& parent) const {
+        const size_t K = actions.size();
+        const double scale = 1.0 / max(1.0, t.hi - t.lo);
+        const double logN = log((double)max<uint32_t>(1, parent.visits));
+        size_t best = 0;
+        double bestScore = -1e300;
+        for (size_t a = 0; a < K; ++a) {
+            const Node& c = t.nodes[parent.firstChild + a];
+            if (c.visits == 0) return a;
+            double score = (c.total / c.visits - t.lo) * scale + cfg.exploration * sqrt(logN / c.visits);
+            if (score > bestScore) { bestScore = score; best = a; }
+        }
+        return best;
+    }
+};
+
+// Auto game where the MCTS advisor picks every plan; the linear advisor keeps
+// learning underneath it as in playAutoGame
+GameResult playMctsGame(uint64_t seed, const GameConfig& cfg, MctsAdvisor& mcts, double* adviceSecs = nullptr) {
+    Game game(seed, cfg);
+    GameResult res;
+    res.seed = seed;
+    for (int w = 1; w <= cfg.weeks; ++w) {
+        MarketEvent ev = game.beginWeek();
+        auto t0 = chrono::steady_clock::now();
+        Plan p = mcts.suggest(game, ev, cfg.weeks);
+        if (adviceSecs) *adviceSecs += chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+        const Snapshot& snap = game.resolveWeek(p, ev);
+        res.weeksPlayed = w;
+        res.unitsSold += snap.sold;
+        res.totalProfit += snap.profit;
+        if (game.bankrupt()) { res.bankrupt = true; break; }
+    }
+    res.finalCash = game.co.cash;
+    return res;
+}
+
+int runMctsBench(int games, int budgetMs) {
+    WorkerPool pool;
+    MctsConfig mc;
+    mc.budgetMs = budgetMs;
+    MctsAdvisor mcts(pool, mc);
+    GameConfig cfg;
+    double mctsProfit = 0.0, linearProfit = 0.0, adviceSecs = 0.0;
+    for (int i = 0; i < games; ++i) {
+        mctsProfit += playMctsGame(1 + i, cfg, mcts, &adviceSecs).totalProfit;
+        linearProfit += playAutoGame(1 + i, cfg).totalProfit;
+    }
+    int calls = games * cfg.weeks;
+    cout << fixed << setprecision(2);
+    cout << "MCTS advisor: " << games << " games, " << pool.size() << " trees, " << budgetMs << " ms budget\n";
+    cout << "  MCTS mean profit    $" << mctsProfit / games << " (" << setprecision(1) << adviceSecs / calls * 1e3
+         << " ms and " << setprecision(0) << (double)mcts.totalRollouts() / calls << " rollouts per suggestion)\n";
+    cout << setprecision(2) << "  linear mean profit  $" << linearProfit / games << " (same seeds)\n";
+    return 0;
+}
+
+// ---------- Scenario Bundles ----------
+// A scenario (regions, categories with pretrained advisor weights, SKUs, a
+// related-SKU graph, the event menu and a supply network) compiled into one
+// relocatable file. Every reference inside is a self-relative offset, so the
+// loader maps the file read-only and hands out pointers into it: no parsing
+// and no allocation. open() checks the magic, version, size, that each
+// top-level array lies inside the file and that the SKU, related-SKU and
+// supply indices stay inside their arrays (one pass over the SKU table).
+template<class T>
+struct BundleArray {
+    int64_t off;     // from this field to element 0
+    uint64_t count;
+
+    const T* data() const { return (const T*)((const char*)this + off); }
+    const T* begin() const { return data(); }
+    const T* end() const { return data() + count; }
+    const T& operator[](size_t i) const { return data()[i]; }
+    size_t size() const { return (size_t)count; }
+};
+
+struct BundleString {
+    BundleArray<char> chars; // NUL-terminated; count excludes the NUL
+    const char* c_str() const { return chars.data(); }
+};
+
+struct BundleRegion {
+    BundleString name;
+    double demandScale;
+};
+
+struct BundleCategory {
+    BundleString name;
+    AdvisorWeights prior; // pretrained starting weights for the category's SKUs
+};
+
+struct BundleSku {
+    uint32_t id;
+    uint16_t category;
+    uint16_t region;
+    float basePrice;
+    float baseDemand;
+    float unitCost;
+    uint32_t supplyNode; // store in the supply network that sells it
+};
+
+struct BundleEvent {
+    BundleString name;
+    double upTo, baseShock, adShock, priceShock;
+};
+
+struct BundleHeader {
+    char magic[8];     // "ATSCN1"
+    uint32_t version;
+    uint32_t headerBytes;
+    uint64_t totalBytes;
+    BundleArray<BundleRegion> regions;
+    BundleArray<BundleCategory> categories;
+    BundleArray<BundleSku> skus;
+    BundleArray<uint64_t> relatedStart; // CSR row starts, skus + 1 entries
+    BundleArray<uint32_t> related;      // CSR columns: related SKU indices
+    BundleArray<BundleEvent> events;
+    BundleArray<SupplyNodeSpec> supply;
+};
+static_assert(is_trivially_copyable<BundleHeader>::value && is_trivially_copyable<SupplyNodeSpec>::value,
+              "bundle records are used in place");
+
+// Builds a bundle in memory. Positions, not pointers, are kept while building
+// because the buffer moves as it grows; links are resolved as they are made.
+class BundleWriter {
+public:
+    BundleWriter() { header = alloc<BundleHeader>(1); }
+
+    template<class T>
+    size_t alloc(size_t n) {
+        size_t at = (buf.size() + alignof(max_align_t) - 1) / alignof(max_align_t) * alignof(max_align_t);
+        buf.resize(at + n * sizeof(T), 0);
+        return at;
+    }
+
+    template<class T>
+    T& at(size_t pos) { return *(T*)(buf.data() + pos); }
+
+    // Point the BundleArray stored at fieldPos to n elements at targetPos
+    template<class T>
+    void link(size_t fieldPos, size_t targetPos, size_t n) {
+        BundleArray<T>& a = at<BundleArray<T>>(fieldPos);
+        a.off = (int64_t)targetPos - (int64_t)fieldPos;
+        a.count = n;
+    }
+
+    // Allocate n elements and link the array at fieldPos to them
+    template<class T>
+    size_t array(size_t fieldPos, size_t n) {
+        size_t pos = alloc<T>(n);
+        link<T>(fieldPos, pos, n);
+        return pos;
+    }
+
+    void text(size_t fieldPos, const string& s) {
+        size_t pos = alloc<char>(s.size() + 1);
+        memcpy(buf.data() + pos, s.c_str(), s.size() + 1);
+        link<char>(fieldPos, pos, s.size());
+    }
+
+    size_t headerPos() const { return header; }
+
+    void save(const string& path) {
+        BundleHeader& h = at<BundleHeader>(header);
+        memcpy(h.magic, "ATSCN1", 7);
+        h.version = 1;
+        h.headerBytes = sizeof(BundleHeader);
+        h.totalBytes = buf.size();
+        int fd = ::open(path.c_str(), O_CREAT | O_TRUNC | O_WRONLY, 0644);
+        if (fd < 0) throw runtime_error("cannot create bundle " + path);
+        for (size_t done = 0; done < buf.size();) {
+            ssize_t w = ::write(fd, buf.data() + done, buf.size() - done);
+            if (w <= 0) { ::close(fd); throw runtime_error("cannot write bundle " + path); }
+            done += (size_t)w;
+        }
+        ::close(fd);
+    }
+
+private:
+    vector<char> buf;
+    size_t header = 0;
+};
+
+class ScenarioBundle {
+public:
+    explicit ScenarioBundle(const string& path) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) throw runtime_error("cannot open bundle " + path);
+        struct stat st;
+        if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(BundleHeader)) {
+            ::close(fd);
+            throw runtime_error("bundle " + path + " is truncated");
+        }
+        bytes = (size_t)st.st_size;
+        void* p = mmap(nullptr, bytes, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (p == MAP_FAILED) throw runtime_error("cannot map bundle " + path);
+        base = (const char*)p;
+        const BundleHeader& h = header();
+        if (memcmp(h.magic, "ATSCN1", 7) != 0 || h.version != 1 || h.headerBytes != sizeof(BundleHeader)
+            || h.totalBytes != bytes || !inside(h.regions) || !inside(h.categories) || !inside(h.skus)
+            || !inside(h.relatedStart) || !inside(h.related) || !inside(h.events) || !inside(h.supply)
+            || h.relatedStart.size() != h.skus.size() + 1 || !linksInRange()) {
+            munmap(p, bytes);
+            throw runtime_error("bundle " + path + " has an unknown layout");
+        }
+    }
+
+    ~ScenarioBundle() { munmap((void*)base, bytes); }
+    ScenarioBundle(const ScenarioBundle&) = delete;
+    ScenarioBundle& operator=(const ScenarioBundle&) = delete;
+
+    const BundleHeader& header() const { return *(const BundleHeader*)base; }
+    const BundleArray<BundleRegion>& regions() const { return header().regions; }
+    const BundleArray<BundleCategory>& categories() const { return header().categories; }
+    const BundleArray<BundleSku>& skus() const { return header().skus; }
+    const BundleArray<BundleEvent>& events() const { return header().events; }
+    const BundleArray<SupplyNodeSpec>& supply() const { return header().supply; }
+    size_t size() const { return bytes; }
+
+    // Related SKUs of SKU i, as [first, last)
+    pair<const uint32_t*, const uint32_t*> related(size_t i) const {
+        const BundleHeader& h = header();
+        return {h.related.data() + h.relatedStart[i], h.related.data() + h.relatedStart[i + 1]};
+    }
+
+private:
+    const char* base = nullptr;
+    size_t bytes = 0;
+
+    template<class T>
+    bool inside(const BundleArray<T>& a) const {
+        const char* p = (const char*)a.data();
+        return p >= base && p <= base + bytes && a.count <= (size_t)(base + bytes - p) / sizeof(T);
+    }
+
+    // Every index stored in the records points into its array, so lookups
+    // after opening need no checks. One pass over the SKUs and the network.
+    bool linksInRange() const {
+        const BundleHeader& h = header();
+        const size_t skus = h.skus.size();
+        for (size_t i = 0; i < skus; ++i) {
+            const BundleSku& s = h.skus[i];
+            if (s.id >= skus || s.region >= h.regions.size() || s.category >= h.categories.size()
+                || s.supplyNode >= h.supply.size())
+                return false;
+            if (h.relatedStart[i] > h.relatedStart[i + 1]) return false;
+        }
+        if (h.relatedStart[0] != 0 || h.relatedStart[skus] > h.related.size()) return false;
+        for (size_t i = 0; i < h.related.size(); ++i)
+            if (h.related[i] >= skus) return false;
+        for (size_t i = 0; i < h.supply.size(); ++i) {
+            int parent = h.supply[i].parent;
+            if (parent < -1 || parent >= (int64_t)h.supply.size()) return false;
+        }
+        return true;
+    }
+};
+
+// Synthetic scenario of the given size, compiled to a bundle
+void buildScenarioBundle(const string& path, size_t skus, uint64_t seed) {
+    const int regions = 12, categories = 40, related = 4;
+    FastRng rng(seed);
+    auto u = [](FastRng& g) { return simUniform(g); };
+    BundleWriter w;
+    const size_t h = w.headerPos();
+
+    size_t rs = w.array<BundleRegion>(h + offsetof(BundleHeader, regions), regions);
+    for (int r = 0; r < regions; ++r) {
+        size_t at = rs + r * sizeof(BundleRegion);
+        w.text(at + offsetof(BundleRegion, name), "Region " + to_string(r + 1));
+        w.at<BundleRegion>(at).demandScale = 0.7 + 0.6 * u(rng);
+    }
+
+    AdvisorConfig prior;
+    size_t cs = w.array<BundleCategory>(h + offsetof(BundleHeader, categories), categories);
+    for (int c = 0; c < categories; ++c) {
+        size_t at = cs + c * sizeof(BundleCategory);
+        w.text(at + offsetof(BundleCategory, name), "Category " + to_string(c + 1));
+        AdvisorWeights p = prior.prior;
+        p.w0 *= 0.8 + 0.4 * u(rng);
+        p.wP *= 0.8 + 0.4 * u(rng);
+        w.at<BundleCategory>(at).prior = p;
+    }
+
+    // Supply network: 4 plants, 8 DCs each, one store per region per DC
+    vector<SupplyNodeSpec> net;
+    for (int p = 0; p < 4; ++p) {
+        int plant = (int)net.size();
+        net.push_back({NodeKind::Plant, -1, 4000, 0, 0, 2000});
+        for (int d = 0; d < 8; ++d) {
+            int dc = (int)net.size();
+            net.push_back({NodeKind::DistributionCenter, plant, 2000, 2, 1500, 600});
+            for (int r = 0; r < regions; ++r) net.push_back({NodeKind::Store, dc, 400, 1, 300, 100});
+        }
+    }
+    size_t ns = w.array<SupplyNodeSpec>(h + offsetof(BundleHeader, supply), net.size());
+    memcpy(&w.at<SupplyNodeSpec>(ns), net.data(), net.size() * sizeof(SupplyNodeSpec));
+
+    size_t ss = w.array<BundleSku>(h + offsetof(BundleHeader, skus), skus);
+    size_t starts = w.array<uint64_t>(h + offsetof(BundleHeader, relatedStart), skus + 1);
+    size_t cols = w.array<uint32_t>(h + offsetof(BundleHeader, related), skus * related);
+    for (size_t i = 0; i < skus; ++i) {
+        BundleSku& s = w.at<BundleSku>(ss + i * sizeof(BundleSku));
+        s.id = (uint32_t)i;
+        s.category = (uint16_t)(rng() % categories);
+        s.region = (uint16_t)(rng() % regions);
+        s.basePrice = (float)(12.0 + 25.0 * u(rng));
+        s.baseDemand = (float)(20.0 + 60.0 * u(rng));
+        s.unitCost = (float)(4.0 + 6.0 * u(rng));
+        int dc = (int)(rng() % 32), perPlant = 1 + 8 * (regions + 1);
+        s.supplyNode = (uint32_t)(dc / 8 * perPlant + 1 + dc % 8 * (regions + 1) + 1 + s.region);
+        w.at<uint64_t>(starts + i * sizeof(uint64_t)) = i * related;
+        for (int k = 0; k < related; ++k)
+            w.at<uint32_t>(cols + (i * related + k) * sizeof(uint32_t)) = (uint32_t)(rng() % skus);
+    }
+    w.at<uint64_t>(starts + skus * sizeof(uint64_t)) = skus * related;
+
+    size_t es = w.array<BundleEvent>(h + offsetof(BundleHeader, events), kEventKinds);
+    for (int e = 0; e < kEventKinds; ++e) {
+        size_t at = es + e * sizeof(BundleEvent);
+        w.text(at + offsetof(BundleEvent, name), kEventTable[e].ev.name);
+        BundleEvent& be = w.at<BundleEvent>(at);
+        be.upTo = kEventTable[e].upTo;
+        be.baseShock = kEventTable[e].ev.baseShock;
+        be.adShock = kEventTable[e].ev.adShock;
+        be.priceShock = kEventTable[e].ev.priceShock;
+    }
+    w.save(path);
+}
+
+int runBundleBuild(const string& path, int skus) {
+    auto t0 = chrono::steady_clock::now();
+    buildScenarioBundle(path, (size_t)max(1, skus), 2024);
+    double secs = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+    cout << "Wrote " << path << " (" << skus << " SKUs) in " << fixed << setprecision(3) << secs << " s\n";
+    return 0;
+}
+
+int runBundleOpen(const string& path) {
+    auto t0 = chrono::steady_clock::now();
+    ScenarioBundle b(path);
+    double openUs = chrono::duration<double, micro>(chrono::steady_clock::now() - t0).count();
+
+    // Use it in place: advise one SKU from its category's pretrained weights
+    const BundleSku& s = b.skus()[b.skus().size() / 2];
+    const BundleCategory& cat = b.categories()[s.category];
+    Plan p = AIAdvisor::suggestFor(cat.prior, 40, s.unitCost, 1200.0, s.baseDemand * b.regions()[s.region].demandScale, 0.0, 0.0);
+    auto rel = b.related(s.id);
+
+    cout << fixed << setprecision(1);
+    cout << "Opened " << path << " (" << b.size() / 1048576.0 << " MiB) in " << openUs << " us: "
+         << b.skus().size() << " SKUs, " << b.categories().size() << " categories, " << b.regions().size()
+         << " regions, " << b.supply().size() << " supply nodes, " << b.events().size() << " events\n";
+    cout << setprecision(2) << "SKU " << s.id << " (" << cat.name.c_str() << ", " << b.regions()[s.region].name.c_str()
+         << ", " << (rel.second - rel.first) << " related): price $" << p.price << ", ad $" << p.adSpend
+         << ", produce " << p.production << "\n";
+    return 0;
+}
+
+// ---------- Decision Logs ----------
+// A game is fully determined by its seed, the configuration and the plans
+// the player chose, so that is all an archive needs. The file holds the
+// configuration once, then per game: varint seed, varint weeks played and
+// the decisions as runs. Each run is a varint count of weeks where the AI
+// plan was accepted, followed by the player's own plan if weeks remain
+// (two raw doubles and a varint). A fully accepted game costs a few bytes in
+// total. A footer indexes game offsets so games replay independently.
+inline void putVarint(vector<uint8_t>& out, uint64_t v) {
+    while (v >= 0x80) { out.push_back((uint8_t)(v | 0x80)); v >>= 7; }
+    out.push_back((uint8_t)v);
+}
+
+inline uint64_t getVarint(const uint8_t*& p, const uint8_t* end) {
+    uint64_t v = 0;
+    for (int shift = 0; p < end && shift < 64; shift += 7) {
+        uint8_t b = *p++;
+        v |= (uint64_t)(b & 0x7F) << shift;
+        if (!(b & 0x80)) return v;
+    }
+    throw runtime_error("truncated decision log");
+}
+
+template<class T>
+void putRaw(vector<uint8_t>& out, const T& v) {
+    const uint8_t* b = (const uint8_t*)&v;
+    out.insert(out.end(), b, b + sizeof(T));
+}
+
+template<class T>
+T getRaw(const uint8_t*& p, const uint8_t* end) {
+    if ((size_t)(end - p) < sizeof(T)) throw runtime_error("truncated decision log");
+    T v;
+    memcpy(&v, p, sizeof(T));
+    p += sizeof(T);
+    return v;
+}
+
+// Every GameConfig field that changes how a game plays, in file order
+template<class F>
+void visitConfigFields(GameConfig& cfg, F&& f) {
+    f(cfg.market.baseDemand); f(cfg.market.demandDrift); f(cfg.market.driftStd);
+    f(cfg.market.priceSensitivity); f(cfg.market.adEffect); f(cfg.market.noiseStd);
+    f(cfg.company.cash); f(cfg.company.unitCost); f(cfg.company.fixedCost);
+    f(cfg.advisor.prior.w0); f(cfg.advisor.prior.wP); f(cfg.advisor.prior.wA);
+    f(cfg.advisor.prior.wB); f(cfg.advisor.prior.wI); f(cfg.advisor.learningRate);
+}
+
+class DecisionLogWriter {
+public:
+    explicit DecisionLogWriter(const GameConfig& cfg) {
+        out.insert(out.end(), {'A', 'T', 'D', 'L', 'O', 'G', '1', 0});
+        GameConfig c = cfg;
+        visitConfigFields(c, [&](double v) { putRaw(out, v); });
+        putVarint(out, (uint64_t)c.company.inventory);
+        putVarint(out, (uint64_t)c.weeks);
+    }
+
+    // Games may be recorded one at a time: beginGame, one record() per week, endGame
+    void beginGame(uint64_t seed) {
+        offsets.push_back(out.size());
+        gameSeed = seed;
+        weeks.clear();
+    }
+
+    void record(bool accepted, const Plan& chosen) { weeks.push_back({accepted, chosen}); }
+
+    void endGame() {
+        putVarint(out, gameSeed);
+        putVarint(out, weeks.size());
+        size_t w = 0;
+        while (w < weeks.size()) {
+            size_t run = 0;
+            while (w < weeks.size() && weeks[w].first) { ++run; ++w; }
+            putVarint(out, run);
+            if (w == weeks.size()) break;
+            putRaw(out, weeks[w].second.price);
+            putRaw(out, weeks[w].second.adSpend);
+            putVarint(out, (uint64_t)weeks[w].second.production);
+            ++w;
+        }
+    }
+
+    // Footer: game offsets, count, magic
+    vector<uint8_t> finish() const {
+        vector<uint8_t> file = out;
+        for (uint64_t o : offsets) putRaw(file, o);
+        putRaw(file, (uint64_t)offsets.size());
+        file.insert(file.end(), {'A', 'T', 'D', 'I', 'D', 'X', '1', 0});
+        return file;
+    }
+
+    void save(const string& path) const {
+        vector<uint8_t> file = finish();
+        FILE* f = fopen(path.c_str(), "wb");
+        if (!f || fwrite(file.data(), 1, file.size(), f) != file.size()) {
+            if (f) fclose(f);
+            throw runtime_error("cannot write decision log " + path);
+        }
+        fclose(f);
+    }
+
+private:
+    vector<uint8_t> out;
+    vector<size_t> offsets;
+    uint64_t gameSeed = 0;
+    vector<pair<bool, Plan>> weeks;
+};
+
+class DecisionLog {
+public:
+    explicit DecisionLog(vector<uint8_t> bytes) : data(move(bytes)) {
+        if (data.size() < 32 || memcmp(data.data(), "ATDLOG1", 8) != 0
+            || memcmp(data.data() + data.size() - 8, "ATDIDX1", 8) != 0)
+            throw runtime_error("not a decision log");
+        const uint8_t* p = data.data() + 8;
+        const uint8_t* end = data.data() + data.size();
+        visitConfigFields(cfg, [&](double& v) { v = getRaw<double>(p, end); });
+        cfg.company.inventory = (int)getVarint(p, end);
+        cfg.weeks = (int)getVarint(p, end);
+        uint64_t n;
+        memcpy(&n, data.data() + data.size() - 16, 8);
+        if (n > (data.size() - 16) / 8) throw runtime_error("corrupt decision log index");
+        index = data.data() + data.size() - 16 - n * 8;
+        count = (size_t)n;
+        bodyEnd = index;
+        // games start after the config, in order, and before the index
+        if (index < p) throw runtime_error("corrupt decision log index");
+        uint64_t prev = (uint64_t)(p - data.data());
+        for (size_t i = 0; i < count; ++i) {
+            uint64_t off;
+            memcpy(&off, index + i * 8, 8);
+            if (off < prev || off >= (uint64_t)(bodyEnd - data.data())) throw runtime_error("corrupt decision log index");
+            prev = off;
+        }
+    }
+
+    static DecisionLog load(const string& path) {
+        FILE* f = fopen(path.c_str(), "rb");
+        if (!f) throw runtime_error("cannot open decision log " + path);
+        vector<uint8_t> bytes;
+        uint8_t buf[65536];
+        for (size_t r; (r = fread(buf, 1, sizeof(buf), f)) > 0;) bytes.insert(bytes.end(), buf, buf + r);
+        fclose(f);
+        return DecisionLog(move(bytes));
+    }
+
+    size_t games() const { return count; }
+    const GameConfig& config() const { return cfg; }
+    size_t bytes() const { return data.size(); }
+
+    // Replays game i, calling onWeek(const Snapshot&) for weeks in [fromWeek, toWeek].
+    // Weeks before fromWeek still have to be simulated; they are just not reported.
+    template<class OnWeek>
+    GameResult replay(size_t i, int fromWeek, int toWeek, OnWeek&& onWeek) const {
+        uint64_t off;
+        memcpy(&off, index + i * 8, 8);
+        const uint8_t* p = data.data() + off;
+        uint64_t seed = getVarint(p, bodyEnd);
+        int played = (int)getVarint(p, bodyEnd);
+        Game game(seed, cfg);
+        GameResult res;
+        res.seed = seed;
+        SuggestBatch advice; // same plans as game.advise, on the faster search
+        uint64_t run = played > 0 ? getVarint(p, bodyEnd) : 0; // a 0-week game has no runs
+        for (int w = 1; w <= played && w <= toWeek; ++w) {
+            MarketEvent ev = game.beginWeek();
+            Plan chosen;
+            if (run > 0) {
+                advice.clear();
+                advice.add(game.adviceRequest(ev));
+                chosen = advice.solve()[0];
+                --run;
+            } else {
+                chosen.price = getRaw<double>(p, bodyEnd);
+                chosen.adSpend = getRaw<double>(p, bodyEnd);
+                chosen.production = (int)getVarint(p, bodyEnd);
+                if (w < played) run = getVarint(p, bodyEnd);
+            }
+            const Snapshot& snap = game.resolveWeek(chosen, ev);
+            if (w >= fromWeek) onWeek(snap);
+            res.weeksPlayed = w;
+            res.unitsSold += snap.sold;
+            res.totalProfit += snap.profit;
+            res.bankrupt = game.bankrupt();
+        }
+        res.finalCash = game.co.cash;
+        return res;
+    }
+
+private:
+    vector<uint8_t> data;
+    GameConfig cfg;
+    const uint8_t* index = nullptr;
+    const uint8_t* bodyEnd = nullptr;
+    size_t count = 0;
+};
+
+// Bots that accept the AI plan most weeks and otherwise nudge it, recorded to
+// a decision log; every game is then replayed in parallel and compared with
+// the snapshots kept during play.
+int runDecisionLogBench(int games, const string& path) {
+    GameConfig cfg;
+    DecisionLogWriter writer(cfg);
+    vector<vector<Snapshot>> played(games);
+    for (int g = 0; g < games; ++g) {
+        uint64_t seed = 1000 + g;
+        Game game(seed, cfg);
+        FastRng bot(seed);
+        writer.beginGame(seed);
+        for (int w = 1; w <= cfg.weeks; ++w) {
+            MarketEvent ev = game.beginWeek();
+            Plan plan = game.advise(ev);
+            bool accept = bot() % 5 != 0;
+            if (!accept) {
+                plan.price = clampv(plan.price + (double)((int)(bot() % 5) - 2), 9.0, 40.0);
+                plan.production = clampv(plan.production + 10 * ((int)(bot() % 3) - 1), 0, 200);
+            }
+            writer.record(accept, plan);
+            played[g].push_back(game.resolveWeek(plan, ev));
+            if (game.bankrupt()) break;
+        }
+        writer.endGame();
+    }
+    writer.save(path);
+
+    auto same = [](const Snapshot& a, const Snapshot& b) {
+        return a.week == b.week && a.baseDemand == b.baseDemand && a.price == b.price && a.adSpend == b.adSpend
+               && a.production == b.production && a.sold == b.sold && a.inventoryEnd == b.inventoryEnd
+               && a.profit == b.profit;
+    };
+    DecisionLog log = DecisionLog::load(path);
+    WorkerPool pool;
+    atomic<int> mismatches{0};
+    auto t0 = chrono::steady_clock::now();
+    pool.parallelFor(log.games(), 64, [&](size_t b, size_t e) {
+        for (size_t g = b; g < e; ++g) {
+            size_t w = 0;
+            log.replay(g, 1, log.config().weeks, [&](const Snapshot& s) {
+                if (w >= played[g].size() || !same(s, played[g][w])) mismatches++;
+                ++w;
+            });
+            if (w != played[g].size()) mismatches++;
+        }
+    });
+    double secs = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+
+    size_t weeks = 0;
+    for (auto& p : played) weeks += p.size();
+    cout << fixed << setprecision(2);
+    cout << "Decision log: " << games << " games, " << weeks << " weeks, " << log.bytes() << " bytes ("
+         << (double)log.bytes() / games << " per game; full trace " << sizeof(TraceRecord) * weeks / (double)games
+         << ")\n";
+    cout << "Replayed in " << setprecision(3) << secs << " s (" << setprecision(1) << games / secs
+         << " games/s), mismatches: " << mismatches.load() << "\n";
+    return mismatches.load() == 0 ? 0 : 1;
+}
+
+// Prints the snapshots of one logged game, optionally a week range
+int runReplay(const string& path, int game, int fromWeek, int toWeek) {
+    DecisionLog log = DecisionLog::load(path);
+    if (game < 0 || (size_t)game >= log.games()) throw runtime_error("no game " + to_string(game) + " in " + path);
+    cout << fixed << setprecision(2);
+    cout << "week  price      ad  prod  sold  inv     profit\n";
+    GameResult r = log.replay((size_t)game, fromWeek, toWeek, [](const Snapshot& s) {
+        cout << setw(4) << s.week << setw(7) << s.price << setw(8) << s.adSpend << setw(6) << s.production
+             << setw(6) << s.sold << setw(5) << s.inventoryEnd << setw(11) << s.profit << "\n";
+    });
+    cout << "seed " << r.seed << ", profit through week " << r.weeksPlayed << ": $" << r.totalProfit << "\n";
+    return 0;
+}
+
+// ---------- Published Advisor ----------
+// Serving threads call suggest while one learner keeps training. Every update
+// is published as a new immutable AdvisorVersion behind one atomic pointer.
+// A reader names the version it is using in its hazard slot, so readers never
+// lock or see half-written weights, and the learner never waits for them:
+// replaced versions are retired and freed in batches once no slot names them.
+struct AdvisorVersion {
+    AdvisorWeights w;
+    uint64_t version;
+};
+
+class PublishedAdvisor {
+    struct alignas(64) Hazard {
+        atomic<const AdvisorVersion*> ptr{nullptr};
+        atomic<bool> claimed{false};
+    };
+
+public:
+    struct Advice {
+        Plan plan;
+        uint64_t version; // model version the plan came from
+    };
+
+    // One per serving thread; holds a hazard slot until destroyed
+    class Reader {
+    public:
+        Reader(Reader&& o) noexcept : hz(o.hz), cur(o.cur) { o.hz = nullptr; }
+        Reader(const Reader&) = delete;
+        ~Reader() { if (hz) hz->claimed.store(false, memory_order_release); }
+
+        AdvisorVersion snapshot() {
+            const AdvisorVersion* v = acquire();
+            AdvisorVersion copy = *v;
+            hz->ptr.store(nullptr, memory_order_release);
+            return copy;
+        }
+
+        Advice suggest(const Company& c, double baseProxy, double eventAdMult, double eventPriceMult) {
+            const AdvisorVersion* v = acquire();
+            Advice a{AIAdvisor::suggestFor(v->w, c.inventory, c.unitCost, c.fixedCost, baseProxy, eventAdMult, eventPriceMult),
+                     v->version};
+            hz->ptr.store(nullptr, memory_order_release);
+            return a;
+        }
+
+    private:
+        friend class PublishedAdvisor;
+        Reader(Hazard* hz, const atomic<AdvisorVersion*>* cur) : hz(hz), cur(cur) {}
+        Hazard* hz;
+        const atomic<AdvisorVersion*>* cur;
+
+        // Publish the hazard, then confirm the version is still current
+        const AdvisorVersion* acquire() {
+            const AdvisorVersion* v = cur->load(memory_order_acquire);
+            for (;;) {
+                hz->ptr.store(v, memory_order_seq_cst);
+                const AdvisorVersion* again = cur->load(memory_order_seq_cst);
+                if (again == v) return v;
+                v = again;
+            }
+        }
+    };
+
+    explicit PublishedAdvisor(const AdvisorConfig& cfg = AdvisorConfig(), size_t maxReaders = 64)
+        : learner(cfg), hazards(maxReaders)
+    {
+        current.store(new AdvisorVersion{learner.weights(), 1}, memory_order_release);
+    }
+
+    ~PublishedAdvisor() {
+        delete current.load();
+        for (AdvisorVersion* v : retired) delete v;
+    }
+
+    Reader reader() {
+        for (Hazard& h : hazards) {
+            bool expected = false;
+            if (h.claimed.compare_exchange_strong(expected, true, memory_order_acq_rel)) return Reader(&h, &current);
+        }
+        throw runtime_error("no free advisor reader slots");
+    }
+
+    // Learner thread only
+    void learn(double price, double ad, double baseProxy, int inventoryAvail,
+               int sold, double eventAdMult, double eventPriceMult)
+    {
+        learner.learn(price, ad, baseProxy, inventoryAvail, sold, eventAdMult, eventPriceMult);
+        AdvisorVersion* fresh = new AdvisorVersion{learner.weights(), ++latest};
+        retired.push_back(current.exchange(fresh, memory_order_seq_cst));
+        if (retired.size() >= 2 * hazards.size()) reclaim();
+    }
+
+    uint64_t version() const { return current.load(memory_order_acquire)->version; }
+    size_t backlog() const { return retired.size(); }
+
+private:
+    AIAdvisor learner;
+    atomic<AdvisorVersion*> current{nullptr};
+    vector<Hazard> hazards;
+    vector<AdvisorVersion*> retired;
+    uint64_t latest = 1;
+
+    void reclaim() {
+        vector<const AdvisorVersion*> held;
+        for (Hazard& h : hazards)
+            if (const AdvisorVersion* p = h.ptr.load(memory_order_seq_cst)) held.push_back(p);
+        sort(held.begin(), held.end());
+        size_t kept = 0;
+        for (AdvisorVersion* v : retired) {
+            if (binary_search(held.begin(), held.end(), (const AdvisorVersion*)v)) retired[kept++] = v;
+            else delete v;
+        }
+        retired.resize(kept);
+    }
+};
+
+// Readers serve suggestions while a learner trains on market outcomes
+// flat out; readers check that the versions they see never go backwards.
+int runPublishedAdvisorBench(int readers, int seconds) {
+    PublishedAdvisor advisor(AdvisorConfig(), (size_t)readers + 1);
+    atomic<bool> stop{false};
+    atomic<uint64_t> served{0}, reads{0}, regressions{0};
+    size_t maxBacklog = 0;
+    uint64_t updates = 0;
+
+    vector<thread> pool;
+    for (int r = 0; r < readers; ++r)
+        pool.emplace_back([&, r] {
+            PublishedAdvisor::Reader rd = advisor.reader();
+            Company co;
+            uint64_t last = 0, n = 0, m = 0;
+            while (!stop.load(memory_order_relaxed)) {
+                // mostly cheap weight reads, with a full suggestion now and then
+                for (int i = 0; i < 64; ++i, ++m) {
+                    AdvisorVersion v = rd.snapshot();
+                    if (v.version < last) regressions++;
+                    last = v.version;
+                }
+                PublishedAdvisor::Advice a = rd.suggest(co, 50.0 + r, 0.0, 0.0);
+                if (a.version < last) regressions++;
+                last = a.version;
+                ++n;
+            }
+            served += n;
+            reads += m;
+        });
+
+    thread learnerThread([&] {
+        Market mk;
+        Rng rng(7);
+        uniform_real_distribution<double> price(9.0, 40.0), ad(0.0, 8000.0);
+        while (!stop.load(memory_order_relaxed)) {
+            MarketEvent ev = mk.nextEvent(0, rng);
+            double p = price(rng), a = ad(rng);
+            int sold = mk.realizeDemand(p, a, ev, 200, rng);
+            advisor.learn(p, a, mk.baseDemand, 200, sold, ev.adShock, ev.priceShock);
+            maxBacklog = max(maxBacklog, advisor.backlog());
+            ++updates;
+        }
+    });
+
+    this_thread::sleep_for(chrono::seconds(seconds));
+    stop = true;
+    for (auto& t : pool) t.join();
+    learnerThread.join();
+
+    cout << fixed << setprecision(0);
+    cout << "Published advisor: " << readers << " readers, 1 learner, " << seconds << " s\n";
+    cout << "  " << served.load() / (double)seconds << " suggestions/s, " << reads.load() / (double)seconds
+         << " weight reads/s, " << updates / (double)seconds << " publishes/s\n";
+    cout << "  latest version " << advisor.version() << ", peak retired backlog " << maxBacklog
+         << ", version regressions " << regressions.load() << "\n";
+    return regressions.load() == 0 ? 0 : 1;
+}
+
+// ---------- Advisor Service ----------
+// suggest() as a local TCP service that sheds or degrades work under bursts
+// instead of queueing without bound. One I/O thread polls clients and admits
+// requests; worker threads answer them from a PublishedAdvisor. Admission:
+//   1. each client has a token bucket; no token -> SHED rate
+//   2. queue at maxQueue -> SHED queue
+//   3. if the expected wait would break the latency SLO, the request is
+//      degraded: the client's last full plan for the same event if it has
+//      one, else a coarse-grid search (also applied by workers to requests
+//      that already waited half the SLO in the queue)
+// Protocol, one line each way:
+//   SUGGEST <id> <inventory> <baseProxy> <adShock> <priceShock>
+//     -> PLAN <id> <price> <ad> <production> full|coarse|cached <version>
+//     -> SHED <id> rate|queue
+//   LEARN <price> <ad> <baseProxy> <inventoryAvail> <sold> <adShock> <priceShock>
+//   STATS -> STATS <accepted> <full> <coarse> <cached> <shedRate> <shedQueue>
+struct ServiceConfig {
+    int workers = 2;
+    double clientRate = 200.0;  // sustained requests/s per client
+    double clientBurst = 40.0;  // bucket size
+    size_t maxQueue = 128;
+    double sloMs = 10.0;        // target time from admission to answer
+};
+
+struct TokenBucket {
+    double tokens = 0.0, rate = 0.0, burst = 0.0;
+    uint64_t lastUs = 0;
+
+    bool take(uint64_t nowUs) {
+        tokens = min(burst, tokens + (double)(nowUs - lastUs) * 1e-6 * rate);
+        lastUs = nowUs;
+        if (tokens < 1.0) return false;
+        tokens -= 1.0;
+        return true;
+    }
+};
+
+// Same model, a 6x5x5 grid instead of 32x17x13
+inline Plan coarseSuggest(const AdvisorWeights& w, int inventory, double unitCost, double fixedCost,
+                          double baseProxy, double eventAdMult, double eventPriceMult) {
+    double bestProfit = -1e18;
+    Plan best{20, 1000, 50};
+    for (double price = 10.0; price <= 40.0; price += 6.0)
+        for (double ad = 0.0; ad <= 8000.0; ad += 2000.0)
+            for (int prod = 0; prod <= 120; prod += 30) {
+                double x[kAdvisorFeatures];
+                advisorFeatures(price, ad, baseProxy, inventory + prod, eventAdMult, eventPriceMult, x);
+                double demandHat = max(0.0, w.w0 * x[0] + w.wP * x[1] + w.wA * x[2] + w.wB * x[3] + w.wI * x[4]);
+                int canSell = min((int)round(demandHat), inventory + prod);
+                double profit = canSell * price - (prod * unitCost + ad + fixedCost);
+                if (profit > bestProfit) { bestProfit = profit; best = {price, ad, prod}; }
+            }
+    return best;
+}
+
+class AdvisorService {
+public:
+    enum Mode : int { kFull = 0, kCoarse = 1, kCached = 2 };
+
+    struct Metrics {
+        atomic<uint64_t> accepted{0}, answered[3] = {}, shedRate{0}, shedQueue{0};
+    };
+
+    AdvisorService(int port, const ServiceConfig& cfg) : cfg(cfg), advisor(AdvisorConfig(), (size_t)cfg.workers + 1) {
+        lfd = listenTcp(port);
+        setNonBlocking(lfd);
+        if (pipe(wake) != 0) throw runtime_error("pipe() failed");
+        fcntl(wake[0], F_SETFL, O_NONBLOCK);
+    }
+
+    ~AdvisorService() {
+        ::close(lfd);
+        ::close(wake[0]);
+        ::close(wake[1]);
+    }
+
+    int port() const { return boundPort(lfd); }
+    const Metrics& metrics() const { return stats; }
+
+    // Serves until stop is set
+    void run(const atomic<bool>& stop) {
+        signal(SIGPIPE, SIG_IGN);
+        vector<thread> workers;
+        for (int i = 0; i < cfg.workers; ++i) workers.emplace_back([this] { workerLoop(); });
+        t0 = chrono::steady_clock::now();
+        vector<pollfd> pfds;
+        vector<Completion> done;
+        while (!stop.load(memory_order_relaxed)) {
+            pfds.clear();
+            pfds.push_back({lfd, POLLIN, 0});
+            pfds.push_back({wake[0], POLLIN, 0});
+            for (auto& c : clients) pfds.push_back({c.io.fd, (short)(POLLIN | (c.io.out.empty() ? 0 : POLLOUT)), 0});
+            poll(pfds.data(), pfds.size(), 5);
+            if (pfds[0].revents & POLLIN) {
+                int fd;
+                while ((fd = accept(lfd, nullptr, nullptr)) >= 0) {
+                    setNonBlocking(fd);
+                    Client c;
+                    c.id = nextClient++;
+                    c.io.fd = fd;
+                    c.bucket = {cfg.clientBurst, cfg.clientRate, cfg.clientBurst, nowUs()};
+                    clients.push_back(move(c));
+                }
+            }
+            if (pfds[1].revents & POLLIN) {
+                char buf[256];
+                while (read(wake[0], buf, sizeof(buf)) > 0) {}
+            }
+            for (size_t i = 2; i < pfds.size(); ++i) {
+                Client& c = clients[i - 2];
+                if (!(pfds[i].revents & (POLLIN | POLLHUP | POLLERR))) continue;
+                if (!c.io.fill()) { c.dead = true; continue; }
+                string line;
+                while (c.io.popLine(line)) handle(c, line);
+            }
+
+            {
+                lock_guard<mutex> lk(doneMutex);
+                done.swap(completed);
+            }
+            for (const Completion& d : done) {
+                auto it = find_if(clients.begin(), clients.end(), [&](const Client& c) { return c.id == d.client; });
+                if (it == clients.end()) continue;
+                if (d.mode == kFull) {
+                    it->cached = d.plan;
+                    it->cachedAd = d.adShock;
+                    it->cachedPrice = d.priceShock;
+                    it->cachedVersion = d.version;
+                    it->hasCached = true;
+                }
+                reply(*it, d.requestId, d.plan, d.mode, d.version);
+            }
+            done.clear();
+
+            for (auto& c : clients)
+                if (!c.dead && !c.io.flush()) c.dead = true;
+            for (auto& c : clients)
+                if (c.dead) c.io.close();
+            clients.erase(remove_if(clients.begin(), clients.end(), [](const Client& c) { return c.dead; }), clients.end());
+        }
+        {
+            lock_guard<mutex> lk(queueMutex);
+            stopping = true;
+        }
+        queueCv.notify_all();
+        for (auto& t : workers) t.join();
+        for (auto& c : clients) c.io.close();
+    }
+
+private:
+    struct Client {
+        int id;
+        LineConn io;
+        TokenBucket bucket;
+        Plan cached{20, 1000, 50};
+        double cachedAd = 0.0, cachedPrice = 0.0;
+        uint64_t cachedVersion = 0; // model version the cached plan came from
+        bool hasCached = false, dead = false;
+    };
+    struct Request {
+        int client;
+        uint64_t requestId;
+        Company company;
+        double baseProxy, adShock, priceShock;
+        Mode mode;
+        uint64_t admittedUs;
+    };
+    struct Completion {
+        int client;
+        uint64_t requestId;
+        Plan plan;
+        Mode mode;
+        uint64_t version;
+        double adShock, priceShock;
+    };
+
+    ServiceConfig cfg;
+    PublishedAdvisor advisor;
+    int lfd = -1, wake[2] = {-1, -1};
+    vector<Client> clients;
+    int nextClient = 0;
+    chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+    Metrics stats;
+
+    mutex queueMutex;
+    condition_variable queueCv;
+    deque<Request> queue;
+    bool stopping = false;
+    atomic<double> fullUs{200.0}; // EWMA service time of a full search
+
+    mutex doneMutex;
+    vector<Completion> completed;
+
+    uint64_t nowUs() const {
+        return (uint64_t)chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - t0).count();
+    }
+
+    void reply(Client& c, uint64_t id, const Plan& p, Mode mode, uint64_t version) {
+        static const char* names[] = {"full", "coarse", "cached"};
+        ostringstream os;
+        os << fixed << setprecision(2) << "PLAN " << id << " " << p.price << " " << p.adSpend << " " << p.production
+           << " " << names[mode] << " " << version << "\n";
+        c.io.out += os.str();
+        stats.answered[mode]++;
+    }
+
+    void handle(Client& c, const string& line) {
+        istringstream is(line);
+        string cmd;
+        is >> cmd;
+        if (cmd == "SUGGEST") {
+            Request r;
+            r.client = c.id;
+            if (!(is >> r.requestId >> r.company.inventory >> r.baseProxy >> r.adShock >> r.priceShock)) return;
+            uint64_t now = nowUs();
+            if (!c.bucket.take(now)) {
+                c.io.out += "SHED " + to_string(r.requestId) + " rate\n";
+                stats.shedRate++;
+                return;
+            }
+            size_t depth;
+            {
+                lock_guard<mutex> lk(queueMutex);
+                depth = queue.size();
+            }
+            if (depth >= cfg.maxQueue) {
+                c.io.out += "SHED " + to_string(r.requestId) + " queue\n";
+                stats.shedQueue++;
+                return;
+            }
+            stats.accepted++;
+            double expectedUs = (depth / (double)cfg.workers + 1.0) * fullUs.load(memory_order_relaxed);
+            r.mode = kFull;
+            if (expectedUs > cfg.sloMs * 1000.0) {
+                if (c.hasCached && c.cachedAd == r.adShock && c.cachedPrice == r.priceShock) {
+                    reply(c, r.requestId, c.cached, kCached, c.cachedVersion);
+                    return;
+                }
+                r.mode = kCoarse;
+            }
+            r.admittedUs = now;
+            {
+                lock_guard<mutex> lk(queueMutex);
+                queue.push_back(r);
+            }
+            queueCv.notify_one();
+        } else if (cmd == "LEARN") {
+            double price, ad, proxy, adShock, priceShock;
+            int avail, sold;
+            if (is >> price >> ad >> proxy >> avail >> sold >> adShock >> priceShock)
+                advisor.learn(price, ad, proxy, avail, sold, adShock, priceShock);
+        } else if (cmd == "STATS") {
+            ostringstream os;
+            os << "STATS " << stats.accepted << " " << stats.answered[kFull] << " " << stats.answered[kCoarse] << " "
+               << stats.answered[kCached] << " " << stats.shedRate << " " << stats.shedQueue << "\n";
+            c.io.out += os.str();
+        }
+    }
+
+    void workerLoop() {
+        PublishedAdvisor::Reader reader = advisor.reader();
+        for (;;) {
+            Request r;
+            {
+                unique_lock<mutex> lk(queueMutex);
+                queueCv.wait(lk, [&] { return stopping || !queue.empty(); });
+                if (stopping) return;
+                r = queue.front();
+                queue.pop_front();
+            }
+            uint64_t start = nowUs();
+            if (r.mode == kFull && (double)(start - r.admittedUs) > cfg.sloMs * 500.0) r.mode = kCoarse;
+            Completion d{r.client, r.requestId, Plan{}, r.mode, 0, r.adShock, r.priceShock};
+            if (r.mode == kFull) {
+                PublishedAdvisor::Advice a = reader.suggest(r.company, r.baseProxy, r.adShock, r.priceShock);
+                d.plan = a.plan;
+                d.version = a.version;
+                double took = (double)(nowUs() - start);
+                fullUs.store(0.9 * fullUs.load(memory_order_relaxed) + 0.1 * took, memory_order_relaxed);
+            } else {
+                AdvisorVersion v = reader.snapshot();
+                d.plan = coarseSuggest(v.w, r.company.inventory, r.company.unitCost, r.company.fixedCost,
+                                       r.baseProxy, r.adShock, r.priceShock);
+                d.version = v.version;
+            }
+            {
+                lock_guard<mutex> lk(doneMutex);
+                completed.push_back(d);
+            }
+            char one = 1;
+            ssize_t ignored = write(wake[1], &one, 1);
+            (void)ignored;
+        }
+    }
+};
+
+// Bursty clients: each second, 20% of the time at 4x the mean rate and the
+// rest at a quarter of it. Reports client-side latency per answer mode.
+struct LoadReport {
+    uint64_t sent = 0, answered[3] = {}, shedRate = 0, shedQueue = 0;
+    vector<double> latencyMs[3];
+};
+
+LoadReport runAdvisorLoad(const string& host, int port, int clients, int seconds, double ratePerClient) {
+    struct Conn { LineConn io; double nextSendS = 0.0; unordered_map<uint64_t, double> pending; };
+    vector<Conn> conns(clients);
+    for (auto& c : conns) {
+        c.io.fd = connectTcp(host, port);
+        setNonBlocking(c.io.fd);
+    }
+    LoadReport rep;
+    FastRng rng(99);
+    uniform_real_distribution<double> u(0.0, 1.0);
+    auto t0 = chrono::steady_clock::now();
+    auto now = [&] { return chrono::duration<double>(chrono::steady_clock::now() - t0).count(); };
+    uint64_t nextId = 1;
+    vector<pollfd> pfds(clients);
+    double end = seconds;
+    while (now() < end + 0.5) {
+        double t = now();
+        for (auto& c : conns) {
+            while (t < end && c.nextSendS <= t) {
+                const MarketEvent& ev = kEventTable[rng() % kEventKinds].ev;
+                ostringstream os;
+                os << fixed << setprecision(2) << "SUGGEST " << nextId << " " << (int)(u(rng) * 120) << " "
+                   << 30.0 + 40.0 * u(rng) << " " << ev.adShock << " " << ev.priceShock << "\n";
+                c.io.out += os.str();
+                c.pending[nextId++] = t;
+                ++rep.sent;
+                double rate = ratePerClient * (fmod(t, 1.0) < 0.2 ? 4.0 : 0.25);
+                c.nextSendS += -log(1.0 - u(rng)) / rate;
+            }
+            if (c.nextSendS < t - 1.0) c.nextSendS = t; // do not bank missed sends
+            c.io.flush();
+        }
+        for (int i = 0; i < clients; ++i) pfds[i] = {conns[i].io.fd, POLLIN, 0};
+        poll(pfds.data(), pfds.size(), 1);
+        for (int i = 0; i < clients; ++i) {
+            if (!(pfds[i].revents & POLLIN)) continue;
+            Conn& c = conns[i];
+            c.io.fill();
+            string line;
+            double at = now();
+            while (c.io.popLine(line)) {
+                istringstream is(line);
+                string kind, mode;
+                uint64_t id = 0;
+                is >> kind >> id;
+                auto it = c.pending.find(id);
+                if (it == c.pending.end()) continue;
+                if (kind == "PLAN") {
+                    double price, ad;
+                    int prod;
+                    is >> price >> ad >> prod >> mode;
+                    int m = mode == "full" ? 0 : mode == "coarse" ? 1 : 2;
+                    rep.answered[m]++;
+                    rep.latencyMs[m].push_back((at - it->second) * 1e3);
+                } else if (kind == "SHED") {
+                    is >> mode;
+                    (mode == "rate" ? rep.shedRate : rep.shedQueue)++;
+                }
+                c.pending.erase(it);
+            }
+        }
+    }
+    for (auto& c : conns) c.io.close();
+    return rep;
+}
+
+void printLoadReport(const LoadReport& rep, int seconds) {
+    static const char* names[] = {"full", "coarse", "cached"};
+    cout << fixed << setprecision(1);
+    cout << "Sent " << rep.sent << " requests (" << rep.sent / (double)seconds << "/s): shed "
+         << rep.shedRate << " by rate, " << rep.shedQueue << " by queue\n";
+    for (int m = 0; m < 3; ++m) {
+        vector<double> v = rep.latencyMs[m];
+        if (v.empty()) { cout << "  " << left << setw(7) << names[m] << right << "      0\n"; continue; }
+        sort(v.begin(), v.end());
+        cout << "  " << left << setw(7) << names[m] << right << setw(7) << v.size() << "  p50 " << setprecision(2)
+             << v[v.size() / 2] << " ms  p99 " << v[min(v.size() - 1, v.size() * 99 / 100)] << " ms\n" << setprecision(1);
+    }
+}
+
+int runAdvisorServer(int port, int workers) {
+    ServiceConfig cfg;
+    cfg.workers = max(1, workers);
+    AdvisorService svc(port, cfg);
+    cout << "Advisor service on port " << svc.port() << " with " << cfg.workers << " workers\n" << flush;
+    atomic<bool> stop{false};
+    svc.run(stop);
+    return 0;
+}
+
+int runAdvisorLoadgen(const string& host, int port, int clients, int seconds, double rate) {
+    printLoadReport(runAdvisorLoad(host, port, clients, seconds, rate), seconds);
+    return 0;
+}
+
+// Service and load generator in one process
+int runAdvisorServiceBench(int clients, int seconds, double rate) {
+    ServiceConfig cfg;
+    AdvisorService svc(0, cfg);
+    atomic<bool> stop{false};
+    thread server([&] { svc.run(stop); });
+    LoadReport rep = runAdvisorLoad("127.0.0.1", svc.port(), clients, seconds, rate);
+    stop = true;
+    server.join();
+    cout << "Advisor service: " << cfg.workers << " workers, " << cfg.sloMs << " ms SLO, queue " << cfg.maxQueue
+         << ", " << clients << " clients at " << rate << " req/s mean (bursty)\n";
+    printLoadReport(rep, seconds);
+    return 0;
+}
+
+// ---------- Similar Weeks ----------
+// Case memory for the advisor: every played week is stored with what was
+// known before the plan (event, proxy, inventory, cash, recent sales) and
+// what happened. SimilarWeekIndex is an inverted-file index: k-means cells
+// over the feature space, each holding its distinct int8 codes in one
+// contiguous array, so a query ranks the cells and scans the nprobe closest.
+// New weeks go straight into their nearest cell. Case-based advice looks up
+// the nearest weeks, measures how far the current model's prediction was
+// from what they actually sold, and shifts the model's intercept by the
+// (shrunk) mean miss before searching for a plan.
+constexpr int kCaseDims = 8;
+
+struct WeekCase {
+    float price, adSpend, baseProxy, adShock, priceShock;
+    int16_t production, inventoryAvail, sold;
+};
+
+inline void caseFeatures(const MarketEvent& ev, double baseProxy, int inventory, double cash,
+                         const vector<Snapshot>& history, float out[kCaseDims]) {
+    size_t n = history.size();
+    double last = n ? history[n - 1].sold : 0.0, avg = 0.0;
+    size_t k = min<size_t>(3, n);
+    for (size_t i = n - k; i < n; ++i) avg += history[i].sold;
+    avg = k ? avg / k : 0.0;
+    out[0] = (float)(ev.baseShock / 20.0);
+    out[1] = (float)(ev.adShock * 2.0);
+    out[2] = (float)(ev.priceShock * 4.0);
+    out[3] = (float)(baseProxy / 50.0);
+    out[4] = (float)(inventory / 100.0);
+    out[5] = (float)(cash / 20000.0);
+    out[6] = (float)(last / 50.0);
+    out[7] = (float)(avg / 50.0);
+}
+
+class SimilarWeekIndex {
+public:
+    struct Hit {
+        float dist;  // squared feature distance
+        uint32_t id; // order in which the week was added
+        WeekCase week;
+    };
+
+    explicit SimilarWeekIndex(int lists = 1024) : cellCount(lists), cells(lists) {}
+
+    // k-means cells and int8 scales from a sample of n feature rows
+    void train(const float* rows, size_t n, int iters = 8, uint64_t seed = 1) {
+        // int8 range covers the 99.5th percentile of |x| per dimension; outliers clamp
+        vector<float> mag(n);
+        for (int d = 0; d < kCaseDims; ++d) {
+            for (size_t i = 0; i < n; ++i) mag[i] = fabs(rows[i * kCaseDims + d]);
+            size_t at = min(n - 1, n * 995 / 1000);
+            nth_element(mag.begin(), mag.begin() + at, mag.end());
+            scale[d] = 127.0f / max(mag[at], 1e-6f);
+        }
+        FastRng rng(seed);
+        centroids.resize((size_t)cellCount * kCaseDims);
+        for (int c = 0; c < cellCount; ++c) {
+            const float* seedRow = rows + (rng() % n) * kCaseDims;
+            copy(seedRow, seedRow + kCaseDims, centroids.begin() + c * kCaseDims);
+        }
+        vector<double> sum((size_t)cellCount * kCaseDims);
+        vector<size_t> count(cellCount);
+        for (int it = 0; it < iters; ++it) {
+            fill(sum.begin(), sum.end(), 0.0);
+            fill(count.begin(), count.end(), 0);
+            for (size_t i = 0; i < n; ++i) {
+                int c = nearestCell(rows + i * kCaseDims);
+                count[c]++;
+                for (int d = 0; d < kCaseDims; ++d) sum[c * kCaseDims + d] += rows[i * kCaseDims + d];
+            }
+            for (int c = 0; c < cellCount; ++c)
+                if (count[c])
+                    for (int d = 0; d < kCaseDims; ++d) centroids[c * kCaseDims + d] = (float)(sum[c * kCaseDims + d] / count[c]);
+        }
+    }
+
+    uint32_t add(const float* x, const WeekCase& w) {
+        Cell& cell = cells[nearestCell(x)];
+        int8_t code[kCaseDims];
+        encode(x, code);
+        uint64_t key;
+        memcpy(&key, code, sizeof key);
+        auto [slot, fresh] = cell.slots.try_emplace(key, (uint32_t)cell.head.size());
+        if (fresh) {
+            cell.codes.insert(cell.codes.end(), code, code + kCaseDims);
+            cell.head.push_back(kNone);
+        }
+        uint32_t& head = cell.head[slot->second];
+        cell.next.push_back(head);
+        head = (uint32_t)cell.weeks.size();
+        cell.weeks.push_back(w);
+        cell.ids.push_back((uint32_t)total);
+        cell.rows.insert(cell.rows.end(), x, x + kCaseDims);
+        return (uint32_t)total++;
+    }
+
+    size_t size() const { return total; }
+
+    // k nearest stored weeks among the nprobe closest cells, nearest first.
+    // The int8 scan keeps a shortlist of k * refine weeks, which are then
+    // re-ranked on their exact features (code resolution alone mixes up
+    // neighbours that sit within a quantization step of each other).
+    void search(const float* x, int k, int nprobe, vector<Hit>& out, int refine = 4) const {
+        vector<pair<float, int>> order(cellCount);
+        for (int c = 0; c < cellCount; ++c) order[c] = {dist2(x, &centroids[c * kCaseDims]), c};
+        nprobe = min(nprobe, cellCount);
+        partial_sort(order.begin(), order.begin() + nprobe, order.end());
+
+        int8_t q[kCaseDims];
+        encode(x, q);
+        const size_t want = (size_t)k * max(1, refine);
+        auto worse = [](const Candidate& a, const Candidate& b) { return a.dist < b.dist; }; // max-heap on distance
+        shortlist.clear();
+        for (int p = 0; p < nprobe; ++p) {
+            if (shortlist.size() == want && shortlist.front().dist == 0) break; // nothing can beat exact code matches
+            const uint32_t c = (uint32_t)order[p].second;
+            const Cell& cell = cells[c];
+            const int8_t* codes = cell.codes.data();
+            const size_t n = cell.head.size();
+            for (size_t g = 0; g < n; ++g, codes += kCaseDims) {
+                // partial distances: give up on a code as soon as it is farther than the current worst
+                int32_t bound = shortlist.size() < want ? numeric_limits<int32_t>::max() : shortlist.front().dist;
+                int32_t s = 0;
+                for (int d = 0; d < kCaseDims && s < bound; ++d) {
+                    int32_t diff = (int32_t)codes[d] - q[d];
+                    s += diff * diff;
+                }
+                if (s >= bound) continue;
+                for (uint32_t i = cell.head[g]; i != kNone; i = cell.next[i]) {
+                    if (shortlist.size() == want) {
+                        if (s >= shortlist.front().dist) break;
+                        pop_heap(shortlist.begin(), shortlist.end(), worse);
+                        shortlist.pop_back();
+                    }
+                    shortlist.push_back({s, c, i});
+                    push_heap(shortlist.begin(), shortlist.end(), worse);
+                }
+                if (shortlist.size() == want && shortlist.front().dist == 0) break;
+            }
+        }
+
+        out.clear();
+        for (const Candidate& cand : shortlist) {
+            const Cell& cell = cells[cand.cell];
+            out.push_back({dist2(x, &cell.rows[(size_t)cand.week * kCaseDims]), cell.ids[cand.week], cell.weeks[cand.week]});
+        }
+        size_t keep = min(out.size(), (size_t)k);
+        partial_sort(out.begin(), out.begin() + keep, out.end(), [](const Hit& a, const Hit& b) { return a.dist < b.dist; });
+        out.resize(keep);
+    }
+
+private:
+    static constexpr uint32_t kNone = ~0u;
+
+    // Weeks with identical codes share one code entry (all first weeks of a
+    // game look alike), so a scan costs one distance per distinct code.
+    struct Cell {
+        vector<int8_t> codes;                   // kCaseDims per distinct code
+        vector<uint32_t> head;                  // per code: newest week with it
+        unordered_map<uint64_t, uint32_t> slots; // code bytes -> code entry
+        vector<WeekCase> weeks;
+        vector<uint32_t> next;                  // per week: older week with the same code
+        vector<uint32_t> ids;
+        vector<float> rows;                     // exact features, for re-ranking
+    };
+    struct Candidate {
+        int32_t dist; // squared int8-code distance
+        uint32_t cell, week;
+    };
+
+    int cellCount;
+    vector<Cell> cells;
+    vector<float> centroids;
+    float scale[kCaseDims] = {};
+    size_t total = 0;
+    mutable vector<Candidate> shortlist; // search scratch (one searcher at a time)
+
+    static float dist2(const float* a, const float* b) {
+        float s = 0.0f;
+        for (int d = 0; d < kCaseDims; ++d) s += (a[d] - b[d]) * (a[d] - b[d]);
+        return s;
+    }
+
+    int nearestCell(const float* x) const {
+        int best = 0;
+        float bestD = numeric_limits<float>::max();
+        for (int c = 0; c < cellCount; ++c) {
+            float d = dist2(x, &centroids[c * kCaseDims]);
+            if (d < bestD) { bestD = d; best = c; }
+        }
+        return best;
+    }
+
+    void encode(const float* x, int8_t* code) const {
+        for (int d = 0; d < kCaseDims; ++d) code[d] = (int8_t)clampv(lrintf(x[d] * scale[d]), -127L, 127L);
+    }
+};
+
+// The model's plan after shifting its intercept by the mean miss on similar weeks.
+// Stocked-out neighbours are skipped: their sales only bound demand from below.
+Plan caseAdjustedSuggest(const SimilarWeekIndex& index, const AdvisorWeights& w, const Company& c,
+                         double baseProxy, const MarketEvent& ev, const float* features,
+                         vector<SimilarWeekIndex::Hit>& scratch, int k = 32, int nprobe = 4) {
+    index.search(features, k, nprobe, scratch);
+    double miss = 0.0;
+    int used = 0;
+    for (const auto& h : scratch) {
+        const WeekCase& wk = h.week;
+        if (wk.sold >= wk.inventoryAvail) continue;
+        double x[kAdvisorFeatures];
+        advisorFeatures(wk.price, wk.adSpend, wk.baseProxy, wk.inventoryAvail, wk.adShock, wk.priceShock, x);
+        double yhat = max(0.0, w.w0 * x[0] + w.wP * x[1] + w.wA * x[2] + w.wB * x[3] + w.wI * x[4]);
+        miss += wk.sold - yhat;
+        ++used;
+    }
+    AdvisorWeights adj = w;
+    if (used) adj.w0 += miss / (used + 8.0); // shrink toward no correction when few cases match
+    return AIAdvisor::suggestFor(adj, c.inventory, c.unitCost, c.fixedCost, baseProxy, ev.adShock, ev.priceShock);
+}
+
+// Weeks from games played with random plans (cheap, and they cover the space)
+void collectRandomWeeks(size_t weeks, uint64_t seed, vector<float>& rows, vector<WeekCase>& cases) {
+    GameConfig cfg;
+    FastRng bot(seed);
+    for (uint64_t g = 0; cases.size() < weeks; ++g) {
+        Game game(seed + g, cfg);
+        for (int w = 1; w <= cfg.weeks && cases.size() < weeks; ++w) {
+            MarketEvent ev = game.beginWeek();
+            float f[kCaseDims];
+            caseFeatures(ev, game.baseProxy, game.co.inventory, game.co.cash, game.co.history, f);
+            Plan p{(double)(9 + bot() % 32), 500.0 * (bot() % 17), (int)(10 * (bot() % 13))};
+            double proxy = game.baseProxy;
+            const Snapshot& s = game.resolveWeek(p, ev);
+            rows.insert(rows.end(), f, f + kCaseDims);
+            cases.push_back({(float)p.price, (float)p.adSpend, (float)proxy, (float)ev.adShock, (float)ev.priceShock,
+                             (int16_t)p.production, (int16_t)(s.inventoryEnd + s.sold), (int16_t)s.sold});
+            if (game.bankrupt()) break;
+        }
+    }
+}
+
+int runSimilarWeeksBench(int weeks, int games) {
+    vector<float> rows;
+    vector<WeekCase> cases;
+    auto t0 = chrono::steady_clock::now();
+    collectRandomWeeks((size_t)weeks, 500000, rows, cases);
+    auto t1 = chrono::steady_clock::now();
+    SimilarWeekIndex index;
+    size_t sample = min<size_t>(cases.size(), 32768);
+    index.train(rows.data(), sample);
+    for (size_t i = 0; i < cases.size(); ++i) index.add(&rows[i * kCaseDims], cases[i]);
+    auto t2 = chrono::steady_clock::now();
+
+    // Latency over back-to-back queries, then recall@10 against exact float search
+    const int queries = 2000, checked = 200, k = 10, nprobe = 4;
+    vector<SimilarWeekIndex::Hit> hits;
+    FastRng pick(3);
+    auto s0 = chrono::steady_clock::now();
+    for (int q = 0; q < queries; ++q) index.search(&rows[(pick() % cases.size()) * kCaseDims], k, nprobe, hits);
+    double searchSecs = chrono::duration<double>(chrono::steady_clock::now() - s0).count();
+    double recall = 0.0;
+    vector<float> exact(cases.size()), ranked;
+    for (int q = 0; q < checked; ++q) {
+        const float* x = &rows[(pick() % cases.size()) * kCaseDims];
+        index.search(x, k, nprobe, hits);
+        for (size_t i = 0; i < cases.size(); ++i) {
+            float d = 0.0f;
+            for (int j = 0; j < kCaseDims; ++j) d += (rows[i * kCaseDims + j] - x[j]) * (rows[i * kCaseDims + j] - x[j]);
+            exact[i] = d;
+        }
+        ranked = exact;
+        nth_element(ranked.begin(), ranked.begin() + (k - 1), ranked.end());
+        float kth = ranked[k - 1];
+        // a hit counts if it is no farther than the true k-th neighbour (ties are common)
+        int found = 0;
+        for (const auto& h : hits) found += exact[h.id] <= kth * 1.0001f;
+        recall += found / (double)k;
+    }
+
+    // Advice on fresh games; their weeks join the index as they are played
+    GameConfig cfg;
+    double plain = 0.0, cased = 0.0;
+    for (int g = 0; g < games; ++g) {
+        plain += playAutoGame(1 + g, cfg).totalProfit;
+        Game game(1 + g, cfg);
+        for (int w = 1; w <= cfg.weeks; ++w) {
+            MarketEvent ev = game.beginWeek();
+            float f[kCaseDims];
+            caseFeatures(ev, game.baseProxy, game.co.inventory, game.co.cash, game.co.history, f);
+            Plan p = caseAdjustedSuggest(index, game.ai.weights(), game.co, game.baseProxy, ev, f, hits);
+            double proxy = game.baseProxy;
+            const Snapshot& s = game.resolveWeek(p, ev);
+            index.add(f, {(float)p.price, (float)p.adSpend, (float)proxy, (float)ev.adShock, (float)ev.priceShock,
+                          (int16_t)p.production, (int16_t)(s.inventoryEnd + s.sold), (int16_t)s.sold});
+            cased += s.profit;
+            if (game.bankrupt()) break;
+        }
+    }
+
+    cout << fixed << setprecision(2);
+    cout << "Similar-week index: " << cases.size() << " weeks (collected in "
+         << chrono::duration<double>(t1 - t0).count() << " s, indexed in " << chrono::duration<double>(t2 - t1).count()
+         << " s), 1024 cells, int8 codes + exact re-rank\n";
+    cout << "  query (k=10, nprobe=4): " << setprecision(1) << searchSecs / queries * 1e6 << " us, recall@10 "
+         << setprecision(3) << recall / checked << "\n";
+    cout << setprecision(2) << "  advice over " << games << " games: model $" << plain / games << ", case-adjusted $"
+         << cased / games << " mean profit\n";
+    return 0;
+}
+
+// ---------- Change Points ----------
+// Bayesian online change-point detection (Adams & MacKay) on the advisor's
+// sales residuals. Each stream keeps a distribution over the run length
+// (weeks since the last regime change); residuals within a run share an
+// unknown mean with a normal prior and known noise (the defaults suit the
+// advisor, whose residuals are dominated by model error rather than the
+// market's own noise). Run lengths are capped
+// at maxRun: the last slot stands for "maxRun - 1 weeks or more" and keeps
+// the statistics of the latest maxRun - 1 weeks, so a step is O(maxRun)
+// however long the game (and cheaper while runs are still short). State is stored slot-major across streams, so one
+// update runs each slot's arithmetic over all games in a contiguous loop.
+class ChangePointDetector {
+public:
+    ChangePointDetector(size_t streams, int maxRun = 16, double hazard = 1.0 / 25.0,
+                        double noiseStd = 60.0, double priorStd = 100.0)
+        : n(streams), slots(maxRun), hazard(hazard),
+          prob((size_t)maxRun * streams, 0.0), sum((size_t)maxRun * streams, 0.0),
+          nextProb(prob.size()), nextSum(sum.size()), evidence(streams),
+          shrink(maxRun), norm(maxRun), expo(maxRun), alarmed(streams, 0)
+    {
+        if (maxRun < 2) throw runtime_error("ChangePointDetector: maxRun must be at least 2");
+        constexpr double kPi = 3.14159265358979323846;
+        fill(prob.begin(), prob.begin() + n, 1.0);
+        double noiseVar = noiseStd * noiseStd, ratio = noiseVar / (priorStd * priorStd);
+        for (int j = 0; j < slots; ++j) {
+            // posterior of the run's mean after j residuals summing to s: N(s * shrink, noiseVar * shrink)
+            shrink[j] = 1.0 / (ratio + j);
+            double predVar = noiseVar * shrink[j] + noiseVar;
+            norm[j] = 1.0 / sqrt(2.0 * kPi * predVar);
+            expo[j] = -0.5 / predVar;
+        }
+    }
+
+    // One week of residuals; streams with observed[i] == 0 skip the week
+    void update(const double* x, const uint8_t* observed) {
+        const double stay = 1.0 - hazard;
+        fill(evidence.begin(), evidence.end(), 0.0);
+        // slots past `active` hold no mass yet (runs cannot be longer than the stream)
+        for (int j = 0; j < active; ++j) {
+            const double* p = &prob[(size_t)j * n];
+            const double* s = &sum[(size_t)j * n];
+            double* np = &nextProb[(size_t)min(j + 1, slots - 1) * n];
+            double* ns = &nextSum[(size_t)min(j + 1, slots - 1) * n];
+            const double c = norm[j], e = expo[j], k = shrink[j];
+            if (j == slots - 1) {
+                // the capped slot also feeds itself; its sums came from slot j - 1
+                for (size_t i = 0; i < n; ++i) {
+                    double d = x[i] - s[i] * k;
+                    double g = p[i] * c * simExp(e * d * d);
+                    evidence[i] += g;
+                    np[i] += stay * g;
+                }
+            } else {
+                for (size_t i = 0; i < n; ++i) {
+                    double d = x[i] - s[i] * k;
+                    double g = p[i] * c * simExp(e * d * d);
+                    evidence[i] += g;
+                    np[i] = stay * g;
+                    ns[i] = s[i] + x[i];
+                }
+            }
+        }
+        for (size_t i = 0; i < n; ++i) {
+            nextProb[i] = hazard * evidence[i];
+            nextSum[i] = 0.0;
+        }
+        active = min(active + 1, slots);
+        for (int j = 0; j < active; ++j) {
+            double* p = &prob[(size_t)j * n];
+            double* s = &sum[(size_t)j * n];
+            const double* np = &nextProb[(size_t)j * n];
+            const double* ns = &nextSum[(size_t)j * n];
+            for (size_t i = 0; i < n; ++i) {
+                bool take = observed[i] && evidence[i] > 0.0;
+                p[i] = take ? np[i] / evidence[i] : p[i];
+                s[i] = take ? ns[i] : s[i];
+            }
+        }
+    }
+
+    // Probability that the regime changed within the last `weeks` observations
+    double recentChange(size_t i, int weeks = 2) const {
+        double p = 0.0;
+        for (int j = 1; j <= min(weeks, slots - 1); ++j) p += prob[(size_t)j * n + i];
+        return p;
+    }
+
+    // True once per change: when recentChange crosses `threshold`, re-armed below half of it
+    bool alarm(size_t i, double threshold = 0.5) {
+        double p = recentChange(i);
+        if (!alarmed[i] && p > threshold) {
+            alarmed[i] = 1;
+            return true;
+        }
+        if (alarmed[i] && p < 0.5 * threshold) alarmed[i] = 0;
+        return false;
+    }
+
+    size_t streams() const { return n; }
+
+private:
+    size_t n;
+    int slots, active = 1;
+    double hazard;
+    vector<double> prob, sum;  // [slot][stream]: run-length probability, residual sum
+    vector<double> nextProb, nextSum, evidence;
+    vector<double> shrink, norm, expo; // per slot
+    vector<uint8_t> alarmed;
+};
+
+// Baseline random walk that now and then jumps to a new level; remembers
+// when, so detectors can be scored against the truth.
+struct JumpingDrift : RandomWalkDrift {
+    double jumpOdds = 0.04;   // per week
+    double jumpSize = 25.0;   // up to +/- this many units
+    int weeksDrifted = 0, lastJump = 0;
+
+    template<class G>
+    void drift(G& rng) {
+        RandomWalkDrift::drift(rng);
+        ++weeksDrifted;
+        if (simUniform(rng) < jumpOdds) {
+            double size = jumpSize * (0.5 + 0.5 * simUniform(rng)) * (simUniform(rng) < 0.5 ? -1.0 : 1.0);
+            baseDemand = max(5.0, baseDemand + size);
+            lastJump = weeksDrifted;
+        }
+    }
+};
+
+using JumpingMarket = BasicMarket<JumpingDrift, LinearLogDemand, GaussianNoise, DefaultEvents>;
+
+struct ChangePointRun {
+    double profit = 0.0;       // mean over games
+    long weeks = 0, alarms = 0;
+    long jumps = 0, caught = 0, delaySum = 0; // jumps known only for JumpingMarket
+    double detectorSecs = 0.0;
+};
+
+// What a game's advisor does when its detector raises an alarm
+enum class ChangeReaction { Ignore, UpWeight, Restart };
+
+// Lockstep games with one detector stream each
+template<class M>
+ChangePointRun playWithChangePoints(uint64_t firstSeed, size_t n, const BasicGameConfig<M>& cfg, ChangeReaction reaction) {
+    vector<BasicGame<M>> games;
+    games.reserve(n);
+    for (size_t i = 0; i < n; ++i) games.emplace_back(firstSeed + i, cfg);
+    ChangePointDetector detector(n);
+    SuggestBatch batch;
+    vector<MarketEvent> events(n);
+    vector<double> predicted(n), residual(n);
+    vector<uint8_t> observed(n), live(n, 1);
+    vector<int> pendingJump(n, 0); // week of a jump not yet caught
+    ChangePointRun run;
+    for (int w = 1; w <= cfg.weeks; ++w) {
+        batch.clear();
+        for (size_t i = 0; i < n; ++i)
+            if (live[i]) {
+                events[i] = games[i].beginWeek();
+                batch.add(games[i].adviceRequest(events[i]));
+            }
+        const vector<Plan>& plans = batch.solve();
+        for (size_t i = 0, j = 0; i < n; ++i) {
+            observed[i] = 0;
+            residual[i] = 0.0;
+            if (!live[i]) continue;
+            BasicGame<M>& g = games[i];
+            const Plan& p = plans[j++];
+            const MarketEvent& ev = events[i];
+            int avail = g.co.inventory + p.production;
+            double x[kAdvisorFeatures];
+            advisorFeatures(p.price, p.adSpend, g.baseProxy, avail, ev.adShock, ev.priceShock, x);
+            AdvisorWeights wt = g.ai.weights();
+            double yhat = max(0.0, wt.w0 * x[0] + wt.wP * x[1] + wt.wA * x[2] + wt.wB * x[3] + wt.wI * x[4]);
+            const Snapshot& snap = g.resolveWeek(p, ev);
+            run.profit += snap.profit;
+            ++run.weeks;
+            // a sell-out only bounds demand from below, so it is not evidence
+            if (snap.sold < avail) {
+                observed[i] = 1;
+                residual[i] = snap.sold - yhat;
+            }
+            if (g.bankrupt()) live[i] = 0;
+        }
+        auto t0 = chrono::steady_clock::now();
+        detector.update(residual.data(), observed.data());
+        run.detectorSecs += chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+        for (size_t i = 0; i < n; ++i) {
+            if constexpr (is_same_v<M, JumpingMarket>) {
+                if (games[i].mk.lastJump == w) {
+                    ++run.jumps;
+                    pendingJump[i] = w;
+                }
+            }
+            if (!observed[i] || !detector.alarm(i)) continue;
+            ++run.alarms;
+            if (pendingJump[i] && w - pendingJump[i] <= 4) {
+                ++run.caught;
+                run.delaySum += w - pendingJump[i];
+                pendingJump[i] = 0;
+            }
+            if (reaction == ChangeReaction::UpWeight) games[i].ai.emphasizeRecent(4, 8.0);
+            else if (reaction == ChangeReaction::Restart) games[i].ai = AIAdvisor(cfg.advisor);
+        }
+    }
+    run.profit /= (double)n;
+    return run;
+}
+
+int runChangePointBench(int games, int weeks) {
+    auto report = [&](const char* label, auto cfg) {
+        cfg.weeks = weeks;
+        ChangePointRun plain = playWithChangePoints(1, games, cfg, ChangeReaction::Ignore);
+        double upWeighted = playWithChangePoints(1, games, cfg, ChangeReaction::UpWeight).profit;
+        double restarted = playWithChangePoints(1, games, cfg, ChangeReaction::Restart).profit;
+        cout << "  " << label << ": " << plain.alarms * 100.0 / max(1L, plain.weeks) << " alarms per 100 weeks";
+        if (plain.jumps)
+            cout << ", " << plain.caught * 100.0 / plain.jumps << "% of " << plain.jumps << " jumps caught within 4 weeks (after "
+                 << (double)plain.delaySum / max(1L, plain.caught) << " on average)";
+        cout << "\n    mean profit: ignore $" << plain.profit << ", up-weight recent $" << upWeighted
+             << ", restart advisor $" << restarted << "\n";
+        return plain;
+    };
+    cout << fixed << setprecision(2);
+    cout << "Change points over " << games << " games x " << weeks << " weeks (hazard 1/25, 16 run lengths):\n";
+    report("default market", GameConfig());
+    ChangePointRun jumpy = report("jumping market", BasicGameConfig<JumpingMarket>());
+    cout << "  detector update: " << setprecision(1) << jumpy.detectorSecs / max(1L, jumpy.weeks) * 1e9
+         << " ns per game-week\n";
+    return 0;
+}
+
+// ---------- League ----------
+// Self-play league for advisor variants. A variant is an advisor config
+// (prior weights, learning rate) plus a playing style applied on top of its
+// suggestions. Each round matchmaking seats variants of similar rating
+// together in four-seat matches on a shared market (the multiplayer room
+// model). A round's matches are split across the worker pool; each worker
+// plays its share in lockstep in reused Room structs, answering a week's
+// advice for all of them with one SuggestBatch. Elo ratings are updated in
+// match order afterwards, so a league run is reproducible whatever the
+// thread count. Every few rounds the best learning variant is frozen as a
+// snapshot that stays in the league as a fixed opponent (unless it already
+// has one; the oldest snapshot goes once there are kMaxSnapshots), and the
+// weakest learning variant is replaced by a mutated copy of the best.
+struct LeagueVariant {
+    AdvisorConfig advisor;
+    double priceShift = 0.0; // added to the suggested price
+    double adScale = 1.0;    // multiplies the suggested ad spend
+    double prodScale = 1.0;  // multiplies the suggested production
+    double rating = 1500.0;
+    uint64_t matches = 0;
+    int parent = -1;
+    int generation = 0;
+    bool frozen = false;     // snapshots keep playing (and being rated) but never mutate
+    bool snapshotted = false; // a frozen copy of this variant is already in the league
+};
+
+class League {
+public:
+    static constexpr int kSeats = Room::kMaxSeats;
+
+    League(int variants, WorkerPool& pool, uint64_t seed = 1) : pool(pool), rng(seed) {
+        if (variants < kSeats) throw runtime_error("League: need at least " + to_string(kSeats) + " variants");
+        population.resize(variants);
+        for (int v = 1; v < variants; ++v) population[v] = mutate(population[0], 0);
+    }
+
+    // Plays one round of `matches` matches and rates them
+    void playRound(int matches) {
+        matchmake(matches);
+        rooms.resize(matches);
+        results.resize(matches);
+        pool.parallelFor((size_t)matches, 32, [&](size_t b, size_t e) {
+            thread_local SuggestBatch batch;
+            vector<array<const LeagueVariant*, kSeats>> seats(e - b);
+            for (size_t m = b; m < e; ++m)
+                for (int s = 0; s < kSeats; ++s) seats[m - b][s] = &population[lineups[m][s]];
+            playMatches(&rooms[b], seats.data(), e - b, matchSeed + played + b, batch, &results[b]);
+        });
+        for (int m = 0; m < matches; ++m) rate(lineups[m], results[m]);
+        played += matches;
+        if (++rounds % kSnapshotEvery == 0) evolve();
+    }
+
+    // Profit of seat 0 when `a` sits against three copies of `b`, averaged over games
+    static double headToHead(const LeagueVariant& a, const LeagueVariant& b, int games, uint64_t seed) {
+        vector<Room> r(games);
+        vector<array<const LeagueVariant*, kSeats>> seats(games, {&a, &b, &b, &b});
+        vector<array<double, kSeats>> profit(games);
+        SuggestBatch batch;
+        playMatches(r.data(), seats.data(), games, seed, batch, profit.data());
+        double total = 0.0;
+        for (const auto& p : profit) total += p[0];
+        return total / games;
+    }
+
+    const vector<LeagueVariant>& variants() const { return population; }
+    uint64_t matchesPlayed() const { return played; }
+    int snapshots() const { return snapshotCount; }
+
+    int leader() const {
+        int best = 0;
+        for (int v = 1; v < (int)population.size(); ++v)
+            if (population[v].rating > population[best].rating) best = v;
+        return best;
+    }
+
+private:
+    static constexpr int kWeeks = 12, kSnapshotEvery = 20, kWindow = 8, kMaxSnapshots = 16;
+    static constexpr double kK = 16.0;
+    using Lineup = array<int, kSeats>;
+
+    WorkerPool& pool;
+    FastRng rng;
+    vector<LeagueVariant> population;
+    vector<Lineup> lineups;
+    vector<Room> rooms;                    // reused match state, one per match in a round
+    vector<array<double, kSeats>> results; // profit per seat
+    vector<int> byRating;
+    uint64_t played = 0, rounds = 0, matchSeed = 1;
+    int snapshotCount = 0;
+
+    // Seats an anchor with three variants drawn from its rating neighbourhood
+    void matchmake(int matches) {
+        byRating.resize(population.size());
+        iota(byRating.begin(), byRating.end(), 0);
+        sort(byRating.begin(), byRating.end(), [&](int x, int y) { return population[x].rating > population[y].rating; });
+        const int n = (int)byRating.size();
+        lineups.resize(matches);
+        for (Lineup& l : lineups) {
+            int at = (int)(rng() % n);
+            int span = min(n, 2 * kWindow + 1);
+            int lo = clampv(at - kWindow, 0, n - span);
+            l[0] = byRating[at];
+            for (int s = 1; s < kSeats; ++s) {
+                int v;
+                do v = byRating[lo + rng() % span];
+                while (find(l.begin(), l.begin() + s, v) != l.begin() + s);
+                l[s] = v;
+            }
+        }
+    }
+
+    // Matches on shared markets in lockstep, so each week's advice for all of
+    // them is one SuggestBatch; profit[m][s] is seat s's total profit
+    static void playMatches(Room* rooms, const array<const LeagueVariant*, kSeats>* seats, size_t n, uint64_t seed,
+                            SuggestBatch& batch, array<double, kSeats>* profit)
+    {
+        Company defaults;
+        for (size_t m = 0; m < n; ++m) {
+            Room& r = rooms[m];
+            r = Room{};
+            r.rng = FastRng(seed + m);
+            r.seats = kSeats;
+            r.weeks = kWeeks;
+            for (int s = 0; s < kSeats; ++s) r.seat[s].ai = AIAdvisor(seats[m][s]->advisor);
+        }
+        for (int w = 1; w <= kWeeks; ++w) {
+            batch.clear();
+            for (size_t m = 0; m < n; ++m) {
+                Room& r = rooms[m];
+                r.week = (uint16_t)w;
+                r.market.drift(r.rng);
+                r.event = r.market.nextEvent(w, r.rng);
+                for (int s = 0; s < kSeats; ++s) {
+                    const RoomSeat& st = r.seat[s];
+                    batch.add({st.ai.weights(), st.inventory, defaults.unitCost, defaults.fixedCost, st.baseProxy,
+                               r.event.adShock, r.event.priceShock});
+                }
+            }
+            const vector<Plan>& plans = batch.solve();
+            for (size_t m = 0; m < n; ++m) {
+                Room& r = rooms[m];
+                for (int s = 0; s < kSeats; ++s) {
+                    const Plan& p = plans[m * kSeats + s];
+                    const LeagueVariant& v = *seats[m][s];
+                    r.seat[s].plan = {clampv(p.price + v.priceShift, 1.0, 60.0), p.adSpend * v.adScale,
+                                      clampv((int)lround(p.production * v.prodScale), 0, 200)};
+                }
+                RoomServer::resolveRoom(r, defaults);
+            }
+        }
+        for (size_t m = 0; m < n; ++m)
+            for (int s = 0; s < kSeats; ++s) profit[m][s] = rooms[m].seat[s].cash - defaults.cash;
+    }
+
+    // Every pair in a match counts as one Elo game, scaled so a match moves a rating by at most kK
+    void rate(const Lineup& l, const array<double, kSeats>& profit) {
+        double delta[kSeats] = {};
+        for (int i = 0; i < kSeats; ++i)
+            for (int j = i + 1; j < kSeats; ++j) {
+                double ri = population[l[i]].rating, rj = population[l[j]].rating;
+                double expect = 1.0 / (1.0 + pow(10.0, (rj - ri) / 400.0));
+                double score = profit[i] > profit[j] ? 1.0 : profit[i] < profit[j] ? 0.0 : 0.5;
+                delta[i] += kK / (kSeats - 1) * (score - expect);
+                delta[j] -= kK / (kSeats - 1) * (score - expect);
+            }
+        for (int i = 0; i < kSeats; ++i) {
+            population[l[i]].rating += delta[i];
+            ++population[l[i]].matches;
+        }
+    }
+
+    // Snapshot the best learning variant, then replace the weakest learner with a mutant of it
+    void evolve() {
+        int best = -1, worst = -1;
+        for (int v = 0; v < (int)population.size(); ++v) {
+            if (population[v].frozen) continue;
+            if (best < 0 || population[v].rating > population[best].rating) best = v;
+            if (worst < 0 || population[v].rating < population[worst].rating) worst = v;
+        }
+        if (best == worst) return;
+        // variants are fixed configs, so a second snapshot would be a clone
+        if (!population[best].snapshotted) {
+            population[best].snapshotted = true;
+            LeagueVariant snap = population[best];
+            snap.frozen = true;
+            snap.parent = best;
+            snap.matches = 0;
+            // snapshots sit after the learners, oldest first
+            int frozen = (int)count_if(population.begin(), population.end(), [](const LeagueVariant& v) { return v.frozen; });
+            if (frozen >= kMaxSnapshots) population.erase(population.end() - frozen);
+            population.push_back(snap);
+            ++snapshotCount;
+        }
+        population[worst] = mutate(population[best], best);
+    }
+
+    LeagueVariant mutate(const LeagueVariant& from, int parent) {
+        auto n = [](FastRng& g) { return simNormal(g, 0.0, 1.0); };
+        LeagueVariant v = from;
+        AdvisorWeights& w = v.advisor.prior;
+        w.w0 *= simExp(0.15 * n(rng));
+        w.wP *= simExp(0.15 * n(rng));
+        w.wA *= simExp(0.15 * n(rng));
+        w.wB *= simExp(0.15 * n(rng));
+        v.advisor.learningRate *= simExp(0.3 * n(rng));
+        v.priceShift = clampv(v.priceShift + n(rng), -10.0, 10.0);
+        v.adScale = clampv(v.adScale * simExp(0.2 * n(rng)), 0.1, 4.0);
+        v.prodScale = clampv(v.prodScale * simExp(0.1 * n(rng)), 0.3, 2.0);
+        v.rating = from.rating;
+        v.matches = 0;
+        v.parent = parent;
+        v.generation = from.generation + 1;
+        v.frozen = false;
+        v.snapshotted = false;
+        return v;
+    }
+};
+
+int runLeague(int variants, int rounds, int matchesPerRound) {
+    WorkerPool pool;
+    League league(variants, pool);
+    auto t0 = chrono::steady_clock::now();
+    for (int r = 0; r < rounds; ++r) league.playRound(matchesPerRound);
+    double secs = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+
+    const auto& pop = league.variants();
+    vector<int> order(pop.size());
+    iota(order.begin(), order.end(), 0);
+    sort(order.begin(), order.end(), [&](int a, int b) { return pop[a].rating > pop[b].rating; });
+    cout << fixed << setprecision(2);
+    cout << "League: " << variants << " variants, " << league.matchesPlayed() << " matches in " << secs << " s on "
+         << pool.size() << " threads (" << setprecision(0) << league.matchesPlayed() / secs * 3600.0
+         << " matches/hour), " << league.snapshots() << " snapshots taken, " << pop.size() - variants << " kept\n";
+    cout << "   id  parent  gen   rating  matches  price+   ad x  prod x      lr\n";
+    for (int i = 0; i < min<int>(8, (int)order.size()); ++i) {
+        const LeagueVariant& v = pop[order[i]];
+        cout << setw(5) << order[i] << setw(8) << v.parent << setw(5) << v.generation << setprecision(1) << setw(9)
+             << v.rating << setw(9) << v.matches << setprecision(2) << setw(8) << v.priceShift << setw(7) << v.adScale
+             << setw(8) << v.prodScale << setprecision(5) << setw(9) << v.advisor.learningRate
+             << (v.frozen ? "  snapshot" : "") << "\n";
+    }
+    const LeagueVariant& top = pop[order[0]];
+    LeagueVariant base;
+    cout << setprecision(2) << "Head to head vs three default advisors (1000 games): leader $"
+         << League::headToHead(top, base, 1000, 900000) << ", default $" << League::headToHead(base, base, 1000, 900000)
+         << " mean profit\n";
+    return 0;
+}
+
+// ---------- Job Server ----------
+// One long-lived process runs sweep jobs from several submitters on a shared
+// set of worker threads. Jobs are cut into batches (a grid point and a seed
+// range); a worker that finishes a batch asks the scheduler for the next
+// one, so a job is preempted only at batch boundaries. Fair-share policy:
+// the highest priority class with runnable batches goes first; within it the
+// job with the least virtual time runs, where a batch charges games/weight.
+// New jobs start at the current virtual time, so idle jobs bank no credit.
+// Protocol, one line per request:
+//   SUBMIT <name> <weight> <priority> <gamesPerPoint> [<priceSens> <adEffect> <noiseStd>]
+//     -> JOB <id> | ERR        (without a point the job sweeps the default grid)
+//   STATUS -> JOB <id> <name> <state> <batchesDone>/<batches> <games/s> <waitS> ... END
+//   RESULT <id> -> POINT <priceSens> <adEffect> <noiseStd> <games> <meanCash> <p50Cash> <bankrupt%> ... END | PENDING <id>
+//   CANCEL <id> -> OK <id> | ERR
+struct JobSpec {
+    string name;
+    double weight = 1.0;
+    int priority = 0;          // higher runs first
+    vector<SweepPoint> points;
+    int gamesPerPoint = 100;
+    int batchGames = 32;
+};
+
+struct JobStatus {
+    enum State { Queued, Running, Done, Cancelled };
+    int id = -1;
+    string name;
+    State state = Queued;
+    size_t batchesDone = 0, batches = 0;
+    uint64_t games = 0, preemptions = 0;
+    double waitSecs = 0.0;     // submit to first batch
+    double elapsedSecs = 0.0;  // submit to finish (or now)
+    double gamesPerSec = 0.0;  // since the first batch started
+};
+
+class JobScheduler {
+public:
+    enum class Policy { Fifo, FairShare };
+
+    explicit JobScheduler(unsigned threads = max(1u, thread::hardware_concurrency()), Policy policy = Policy::FairShare)
+        : policy(policy)
+    {
+        for (unsigned t = 0; t < max(1u, threads); ++t) workers.emplace_back([this] { workerLoop(); });
+    }
+
+    ~JobScheduler() {
+        {
+            lock_guard<mutex> lk(m);
+            stopping = true;
+        }
+        work.notify_all();
+        for (auto& t : workers) t.join();
+    }
+
+    int submit(const JobSpec& spec) {
+        if (spec.points.empty() || spec.gamesPerPoint < 1 || !(spec.weight > 0.0))
+            throw runtime_error("JobScheduler: empty job or non-positive weight");
+        auto job = make_unique<Job>();
+        job->spec = spec;
+        int per = max(1, spec.batchGames);
+        for (int p = 0; p < (int)spec.points.size(); ++p)
+            for (int first = 0; first < spec.gamesPerPoint; first += per)
+                job->batches.push_back({p, (uint64_t)first + 1, min(per, spec.gamesPerPoint - first)});
+        job->batchCount = job->batches.size();
+        job->results.resize(spec.points.size());
+        job->submitted = chrono::steady_clock::now();
+        int id;
+        {
+            lock_guard<mutex> lk(m);
+            double now = virtualNow;
+            for (auto& j : jobs)
+                if (runnable(*j)) now = min(now, j->vtime);
+            job->vtime = now;
+            id = (int)jobs.size();
+            jobs.push_back(move(job));
+        }
+        work.notify_all();
+        return id;
+    }
+
+    // Queued batches are dropped; batches already running finish
+    bool cancel(int id) {
+        lock_guard<mutex> lk(m);
+        if (id < 0 || id >= (int)jobs.size() || finishedLocked(*jobs[id])) return false;
+        jobs[id]->cancelled = true;
+        if (jobs[id]->running == 0) finishLocked(*jobs[id]);
+        return true;
+    }
+
+    vector<JobStatus> statuses() const {
+        lock_guard<mutex> lk(m);
+        vector<JobStatus> out;
+        for (int id = 0; id < (int)jobs.size(); ++id) out.push_back(statusLocked(id));
+        return out;
+    }
+
+    // Per-point results once the job has finished
+    bool results(int id, JobSpec& spec, vector<ResultSketch>& out) const {
+        lock_guard<mutex> lk(m);
+        if (id < 0 || id >= (int)jobs.size() || !finishedLocked(*jobs[id])) return false;
+        spec = jobs[id]->spec;
+        out = jobs[id]->results;
+        return true;
+    }
+
+    JobStatus wait(int id) {
+        unique_lock<mutex> lk(m);
+        if (id < 0 || id >= (int)jobs.size()) throw runtime_error("JobScheduler: no job " + to_string(id));
+        finished.wait(lk, [&] { return finishedLocked(*jobs[id]); });
+        return statusLocked(id);
+    }
+
+private:
+    using Clock = chrono::steady_clock;
+    struct Job {
+        JobSpec spec;
+        vector<SweepShard> batches;   // released once the job finishes
+        vector<ResultSketch> results;
+        size_t batchCount = 0, next = 0, done = 0;
+        int running = 0;
+        double vtime = 0.0;
+        uint64_t games = 0, preemptions = 0;
+        bool started = false, cancelled = false, over = false;
+        Clock::time_point submitted, firstBatch, finishedAt;
+    };
+
+    Policy policy;
+    mutable mutex m;
+    condition_variable work, finished;
+    vector<unique_ptr<Job>> jobs;
+    vector<thread> workers;
+    double virtualNow = 0.0;
+    bool stopping = false;
+
+    static bool runnable(const Job& j) { return !j.cancelled && j.next < j.batches.size(); }
+    static bool finishedLocked(const Job& j) { return j.over; }
+
+    void finishLocked(Job& j) {
+        vector<SweepShard>().swap(j.batches);
+        j.over = true;
+        j.finishedAt = Clock::now();
+        finished.notify_all();
+    }
+
+    Job* pick() {
+        Job* best = nullptr;
+        for (auto& j : jobs) {
+            if (!runnable(*j)) continue;
+            if (!best) { best = j.get(); continue; }
+            if (policy == Policy::Fifo) break; // jobs are in submission order
+            if (j->spec.priority != best->spec.priority) {
+                if (j->spec.priority > best->spec.priority) best = j.get();
+            } else if (j->vtime < best->vtime) {
+                best = j.get();
+            }
+        }
+        return best;
+    }
+
+    JobStatus statusLocked(int id) const {
+        const Job& j = *jobs[id];
+        JobStatus s;
+        s.id = id;
+        s.name = j.spec.name;
+        s.state = j.over ? (j.cancelled ? JobStatus::Cancelled : JobStatus::Done)
+                         : (j.started ? JobStatus::Running : JobStatus::Queued);
+        s.batchesDone = j.done;
+        s.batches = j.batchCount;
+        s.games = j.games;
+        s.preemptions = j.preemptions;
+        Clock::time_point end = j.over ? j.finishedAt : Clock::now();
+        s.elapsedSecs = chrono::duration<double>(end - j.submitted).count();
+        if (j.started) {
+            s.waitSecs = chrono::duration<double>(j.firstBatch - j.submitted).count();
+            s.gamesPerSec = j.games / max(1e-9, chrono::duration<double>(end - j.firstBatch).count());
+        } else {
+            s.waitSecs = s.elapsedSecs;
+        }
+        return s;
+    }
+
+    void workerLoop() {
+        Job* last = nullptr;
+        unique_lock<mutex> lk(m);
+        for (;;) {
+            Job* j;
+            work.wait(lk, [&] { return stopping || (j = pick()) != nullptr; });
+            if (stopping) return;
+            // this worker left a job that still had work: it was preempted at the boundary
+            if (last && last != j && runnable(*last)) ++last->preemptions;
+            last = j;
+            SweepShard batch = j->batches[j->next++];
+            virtualNow = max(virtualNow, j->vtime);
+            j->vtime += batch.seeds / j->spec.weight;
+            if (!j->started) {
+                j->started = true;
+                j->firstBatch = Clock::now();
+            }
+            ++j->running;
+            lk.unlock();
+            ResultSketch sk = runSweepShard(j->spec.points, batch);
+            lk.lock();
+            j->results[batch.point].merge(sk);
+            j->games += (uint64_t)batch.seeds;
+            ++j->done;
+            --j->running;
+            if (j->running == 0 && (j->cancelled || j->done == j->batchCount)) finishLocked(*j);
+        }
+    }
+};
+
+int runJobServer(int port, int threads) {
+    signal(SIGPIPE, SIG_IGN);
+    JobScheduler sched((unsigned)max(1, threads));
+    int lfd = listenTcp(port, false);
+    setNonBlocking(lfd);
+    cout << "Job server on port " << boundPort(lfd) << " with " << max(1, threads) << " workers\n" << flush;
+
+    static const char* stateNames[] = {"queued", "running", "done", "cancelled"};
+    struct Client { LineConn io; bool dead = false; };
+    vector<Client> clients;
+    vector<pollfd> pfds;
+    for (;;) {
+        pfds.clear();
+        pfds.push_back({lfd, POLLIN, 0});
+        for (auto& c : clients) pfds.push_back({c.io.fd, (short)(POLLIN | (c.io.out.empty() ? 0 : POLLOUT)), 0});
+        poll(pfds.data(), pfds.size(), 50);
+        if (pfds[0].revents & POLLIN) {
+            int fd;
+            while ((fd = accept(lfd, nullptr, nullptr)) >= 0) {
+                setNonBlocking(fd);
+                Client c;
+                c.io.fd = fd;
+                clients.push_back(move(c));
+            }
+        }
+        for (size_t i = 1; i < pfds.size(); ++i) {
+            Client& c = clients[i - 1];
+            if (!(pfds[i].revents & (POLLIN | POLLHUP | POLLERR))) continue;
+            if (!c.io.fill()) { c.dead = true; continue; }
+            string line;
+            while (c.io.popLine(line)) {
+                istringstream is(line);
+                string cmd;
+                is >> cmd;
+                ostringstream os;
+                os << fixed << setprecision(2);
+                if (cmd == "SUBMIT") {
+                    JobSpec spec;
+                    SweepPoint p;
+                    if (!(is >> spec.name >> spec.weight >> spec.priority >> spec.gamesPerPoint) || !(spec.weight > 0.0)
+                        || spec.gamesPerPoint < 1) {
+                        os << "ERR\n";
+                    } else {
+                        if (is >> p.priceSensitivity >> p.adEffect >> p.noiseStd) spec.points = {p};
+                        else spec.points = defaultSweepGrid();
+                        os << "JOB " << sched.submit(spec) << "\n";
+                    }
+                } else if (cmd == "STATUS") {
+                    for (const JobStatus& s : sched.statuses())
+                        os << "JOB " << s.id << " " << s.name << " " << stateNames[s.state] << " " << s.batchesDone
+                           << "/" << s.batches << " " << s.gamesPerSec << " " << s.waitSecs << "\n";
+                    os << "END\n";
+                } else if (cmd == "RESULT") {
+                    int id = -1;
+                    JobSpec spec;
+                    vector<ResultSketch> res;
+                    is >> id;
+                    if (!sched.results(id, spec, res)) {
+                        os << "PENDING " << id << "\n";
+                    } else {
+                        for (size_t k = 0; k < res.size(); ++k)
+                            os << "POINT " << spec.points[k].priceSensitivity << " " << spec.points[k].adEffect << " "
+                               << spec.points[k].noiseStd << " " << res[k].games << " " << res[k].mean << " "
+                               << res[k].quantile(0.5) << " "
+                               << (res[k].games ? 100.0 * res[k].bankruptcies / res[k].games : 0.0) << "\n";
+                        os << "END\n";
+                    }
+                } else if (cmd == "CANCEL") {
+                    int id = -1;
+                    is >> id;
+                    if (sched.cancel(id)) os << "OK " << id << "\n";
+                    else os << "ERR\n";
+                } else {
+                    os << "ERR\n";
+                }
+                c.io.out += os.str();
+            }
+        }
+        for (auto& c : clients)
+            if (!c.dead && !c.io.flush()) c.dead = true;
+        for (auto& c : clients)
+            if (c.dead) c.io.close();
+        clients.erase(remove_if(clients.begin(), clients.end(), [](const Client& c) { return c.dead; }), clients.end());
+    }
+}
+
+// A big sweep, a smaller one with twice the weight, and a stream of small
+// high-priority what-if queries, under FIFO and under fair share
+int runJobsBench(int threads) {
+    cout << fixed << setprecision(2);
+    for (auto policy : {JobScheduler::Policy::Fifo, JobScheduler::Policy::FairShare}) {
+        JobScheduler sched((unsigned)max(1, threads), policy);
+        JobSpec big{"big-sweep", 1.0, 0, defaultSweepGrid(), 120};
+        JobSpec team{"team-sweep", 2.0, 0, defaultSweepGrid(), 30};
+        int bigId = sched.submit(big);
+        this_thread::sleep_for(chrono::milliseconds(200));
+        int teamId = sched.submit(team);
+        vector<int> queries;
+        for (int q = 0; q < 10; ++q) {
+            this_thread::sleep_for(chrono::milliseconds(300));
+            SweepPoint p{1.0 + 0.08 * q, 9.0, 6.0};
+            queries.push_back(sched.submit({"what-if-" + to_string(q), 1.0, 1, {p}, 64, 16}));
+        }
+        vector<double> latency;
+        for (int id : queries) latency.push_back(sched.wait(id).elapsedSecs);
+        sched.wait(teamId);
+        sched.wait(bigId);
+
+        cout << (policy == JobScheduler::Policy::Fifo ? "FIFO" : "Fair share") << " on " << max(1, threads)
+             << " workers:\n";
+        cout << "  job            games   wait s  elapsed s  games/s  preempted\n";
+        for (const JobStatus& s : sched.statuses()) {
+            if (s.name.rfind("what-if-", 0) == 0 && s.name != "what-if-0") continue;
+            cout << "  " << left << setw(12) << s.name << right << setw(8) << s.games << setw(9) << s.waitSecs
+                 << setw(11) << s.elapsedSecs << setw(9) << setprecision(0) << s.gamesPerSec << setw(11)
+                 << s.preemptions << setprecision(2) << "\n";
+        }
+        sort(latency.begin(), latency.end());
+        cout << "  what-if queries (64 games, priority 1): median " << latency[latency.size() / 2] * 1000.0
+             << " ms, worst " << latency.back() * 1000.0 << " ms\n";
+    }
+    return 0;
+}
+
+// ---------- Re-costing ----------
+// "What would profit have been with other unit costs?" for runs already
+// played. Decisions (price, ad spend, production) and sales are kept; only
+// the books are recomputed, so no game is re-simulated. History is held as
+// columns, games contiguous and weeks in order, loaded from in-memory
+// Company histories or from a trace file (mapped, not read). A pass is two
+// loops per chunk of games: a branch-free one over rows for revenue, cost
+// and profit, then a running sum per game for cash. At the original costs
+// the pass reproduces the recorded columns exactly.
+struct HistoryColumns {
+    vector<uint64_t> gameId;     // per game
+    vector<double> startCash;    // per game
+    vector<size_t> gameStart;    // row offsets, games + 1 entries
+    vector<int32_t> week, production, sold;
+    vector<double> price, adSpend;
+    vector<double> revenue, cost, profit, cash; // as recorded
+
+    HistoryColumns() : gameStart(1, 0) {}
+
+    size_t games() const { return gameId.size(); }
+    size_t rows() const { return price.size(); }
+
+    void addGame(uint64_t id, const vector<Snapshot>& weeks, double initialCash) {
+        gameId.push_back(id);
+        startCash.push_back(initialCash);
+        double c = initialCash;
+        for (const Snapshot& s : weeks) {
+            c += s.profit;
+            addRow(s.week, s.production, s.sold, s.price, s.adSpend, s.revenue, s.cost, s.profit, c);
+        }
+        gameStart.push_back(rows());
+    }
+
+    void addRow(int32_t w, int32_t prod, int32_t units, double p, double ad, double rev, double cst, double pr, double c) {
+        week.push_back(w);
+        production.push_back(prod);
+        sold.push_back(units);
+        price.push_back(p);
+        adSpend.push_back(ad);
+        revenue.push_back(rev);
+        cost.push_back(cst);
+        profit.push_back(pr);
+        cash.push_back(c);
+    }
+};
+
+// Columns from a TraceSink file. Blocks of different lanes interleave, so
+// rows are ordered by (game, week) after loading; a game's starting cash is
+// its first recorded cash minus that week's profit.
+HistoryColumns loadTraceColumns(const string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) throw runtime_error("cannot open trace " + path);
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(TraceBlockHeader)) {
+        ::close(fd);
+        throw runtime_error("trace " + path + " is truncated");
+    }
+    size_t bytes = (size_t)st.st_size;
+    void* p = mmap(nullptr, bytes, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (p == MAP_FAILED) throw runtime_error("cannot map trace " + path);
+    const char* base = (const char*)p;
+    auto headerAt = [&](size_t off, TraceBlockHeader& h) {
+        if (off + sizeof(h) > bytes) return false;
+        memcpy(&h, base + off, sizeof(h));
+        return memcmp(h.magic, "ATRC", 4) == 0 && h.version == 1 && h.recordSize == sizeof(TraceRecord);
+    };
+
+    // The block size is not stored; block 1 sits at the first page boundary holding it
+    TraceBlockHeader h;
+    if (!headerAt(0, h)) {
+        munmap(p, bytes);
+        throw runtime_error("trace " + path + " has an unknown layout");
+    }
+    size_t blockBytes = bytes;
+    for (size_t off = 4096; off < bytes; off += 4096)
+        if (headerAt(off, h) && h.blockIndex == 1) { blockBytes = off; break; }
+
+    vector<const TraceRecord*> recs;
+    for (size_t off = 0; off + sizeof(TraceBlockHeader) <= bytes; off += blockBytes) {
+        if (!headerAt(off, h) || sizeof(h) + (size_t)h.count * sizeof(TraceRecord) > min(blockBytes, bytes - off)) {
+            munmap(p, bytes);
+            throw runtime_error("trace " + path + " has a damaged block at offset " + to_string(off));
+        }
+        const TraceRecord* r = (const TraceRecord*)(base + off + sizeof(h));
+        for (uint32_t i = 0; i < h.count; ++i) recs.push_back(r + i);
+    }
+    sort(recs.begin(), recs.end(), [](const TraceRecord* a, const TraceRecord* b) {
+        return a->gameId != b->gameId ? a->gameId < b->gameId : a->week < b->week;
+    });
+
+    HistoryColumns cols;
+    for (size_t i = 0; i < recs.size(); ++i) {
+        const TraceRecord& r = *recs[i];
+        if (i == 0 || r.gameId != recs[i - 1]->gameId) {
+            if (i) cols.gameStart.push_back(cols.rows());
+            cols.gameId.push_back(r.gameId);
+            cols.startCash.push_back(r.cash - r.profit);
+        }
+        cols.addRow(r.week, r.production, r.sold, r.price, r.adSpend, r.revenue, r.cost, r.profit, r.cash);
+    }
+    if (!recs.empty()) cols.gameStart.push_back(cols.rows());
+    munmap(p, bytes);
+    return cols;
+}
+
+struct Recosted {
+    vector<double> revenue, cost, profit, cash;
+};
+
+// Books for every stored week under new unit and fixed costs
+void recostHistory(const HistoryColumns& h, double unitCost, double fixedCost, Recosted& out, WorkerPool& pool) {
+    size_t n = h.rows();
+    out.revenue.resize(n);
+    out.cost.resize(n);
+    out.profit.resize(n);
+    out.cash.resize(n);
+    pool.parallelFor(h.games(), 4096, [&](size_t gb, size_t ge) {
+        size_t b = h.gameStart[gb], e = h.gameStart[ge];
+        const int32_t* __restrict prod = h.production.data();
+        const int32_t* __restrict units = h.sold.data();
+        const double* __restrict price = h.price.data();
+        const double* __restrict ad = h.adSpend.data();
+        double* __restrict rev = out.revenue.data();
+        double* __restrict cst = out.cost.data();
+        double* __restrict pr = out.profit.data();
+        for (size_t i = b; i < e; ++i) {
+            rev[i] = units[i] * price[i];
+            cst[i] = prod[i] * unitCost + ad[i] + fixedCost; // same operation order as resolveWeek
+            pr[i] = rev[i] - cst[i];
+        }
+        double* __restrict cash = out.cash.data();
+        for (size_t g = gb; g < ge; ++g) {
+            double c = h.startCash[g];
+            for (size_t i = h.gameStart[g]; i < h.gameStart[g + 1]; ++i) cash[i] = (c += pr[i]);
+        }
+    });
+}
+
+// Re-cost a trace file (or, without one, a fresh in-memory run) and compare
+// with re-simulating the same games
+int runRecost(const string& tracePath, double unitCost, double fixedCost, int games) {
+    WorkerPool pool;
+    GameConfig cfg;
+    HistoryColumns h;
+    auto t0 = chrono::steady_clock::now();
+    if (!tracePath.empty()) {
+        h = loadTraceColumns(tracePath);
+    } else {
+        vector<vector<Snapshot>> played(games);
+        pool.parallelFor(played.size(), 64, [&](size_t b, size_t e) {
+            SuggestBatch batch;
+            vector<GameResult> results(e - b);
+            playAutoGamesBatched(b + 1, e - b, cfg, batch, results.data(),
+                                 [&](size_t i, const Game&, const Snapshot& s) { played[b + i].push_back(s); });
+        });
+        for (size_t g = 0; g < played.size(); ++g) h.addGame(g + 1, played[g], cfg.company.cash);
+    }
+    double loadSecs = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+
+    // At the recorded costs the books must come back unchanged
+    Recosted same;
+    recostHistory(h, cfg.company.unitCost, cfg.company.fixedCost, same, pool);
+    size_t mismatched = 0;
+    for (size_t i = 0; i < h.rows(); ++i)
+        mismatched += same.revenue[i] != h.revenue[i] || same.cost[i] != h.cost[i] || same.profit[i] != h.profit[i]
+                      || same.cash[i] != h.cash[i];
+
+    Recosted out;
+    const int reps = 20;
+    auto t1 = chrono::steady_clock::now();
+    for (int r = 0; r < reps; ++r) recostHistory(h, unitCost, fixedCost, out, pool);
+    double passSecs = chrono::duration<double>(chrono::steady_clock::now() - t1).count() / reps;
+
+    double oldProfit = 0.0, newProfit = 0.0;
+    size_t underwater = 0;
+    for (size_t g = 0; g < h.games(); ++g) {
+        bool was = false, now = false;
+        for (size_t i = h.gameStart[g]; i < h.gameStart[g + 1]; ++i) {
+            oldProfit += h.profit[i];
+            newProfit += out.profit[i];
+            was |= h.cash[i] < -5000.0;
+            now |= out.cash[i] < -5000.0;
+        }
+        underwater += now && !was;
+    }
+
+    // What the same question costs by re-simulation (sampled, on the pool
+    // and lockstep-batched like runBatch)
+    size_t sample = min<size_t>(h.games(), 4096);
+    GameConfig changed = cfg;
+    changed.company.unitCost = unitCost;
+    changed.company.fixedCost = fixedCost;
+    auto t2 = chrono::steady_clock::now();
+    pool.parallelFor(sample, 64, [&](size_t b, size_t e) {
+        SuggestBatch batch;
+        vector<GameResult> results(e - b);
+        playAutoGamesBatched(b + 1, e - b, changed, batch, results.data());
+    });
+    double simSecs = chrono::duration<double>(chrono::steady_clock::now() - t2).count() / max<size_t>(1, sample) * h.games();
+
+    // bytes touched: 2 int32 + 2 double inputs, 4 double outputs per row
+    double bytes = (double)h.rows() * (2 * 4 + 2 * 8 + 4 * 8);
+    cout << fixed << setprecision(2);
+    cout << "Re-costing " << h.games() << " games / " << h.rows() << " weeks from "
+         << (tracePath.empty() ? string("memory") : tracePath) << " (loaded in " << loadSecs << " s), " << pool.size()
+         << " threads\n";
+    cout << "  at recorded costs: " << mismatched << " weeks differ from the stored books\n";
+    cout << "  unit $" << unitCost << ", overhead $" << fixedCost << ": " << passSecs * 1000.0 << " ms per pass ("
+         << bytes / passSecs / 1e9 << " GB/s), re-simulating would take ~" << simSecs << " s\n";
+    cout << "  total profit $" << oldProfit << " -> $" << newProfit << " with the same decisions; " << underwater
+         << " more games would have dropped below the bankruptcy line\n";
+    return 0;
+}
+
+// ---------- Multi-Fidelity Screening ----------
+// Strategy configurations (the league's plan adjustments plus the advisor's
+// learning rate) are first scored by a cheap fidelity: the same game on an
+// expected-value market, with no demand noise, no baseline drift noise and
+// the mean event every week, played from a single seed (only the public
+// demand proxy stays noisy). Only the best screened points are promoted to
+// full Monte Carlo on the stochastic market, all on the same seeds. Both
+// fidelities play in lockstep through SuggestBatch. A random sample of points
+// gets both fidelities, so their correlation is measured over the whole space
+// rather than only the top.
+struct PolicyPoint {
+    double priceShift;    // added to the suggested price
+    double adScale;       // multiplies the suggested ad spend
+    double prodScale;     // multiplies the suggested production
+    double learningRate;
+};
+
+using ExpectedMarket = BasicMarket<RandomWalkDrift, LinearLogDemand, NoNoise, ExpectedEvents>;
+
+vector<PolicyPoint> defaultPolicyGrid() {
+    vector<PolicyPoint> pts;
+    for (double ps = -8.0; ps <= 8.0; ps += 2.0)
+        for (double as : {0.25, 0.5, 0.75, 1.0, 1.5, 2.0, 3.0})
+            for (double pr : {0.6, 0.8, 1.0, 1.2, 1.4, 1.6})
+                for (double lr : {0.0005, 0.0015, 0.003, 0.006})
+                    pts.push_back({ps, as, pr, lr});
+    return pts;
+}
+
+struct PolicyGame {
+    uint64_t seed;
+    uint32_t point; // index into the grid
+};
+
+// Plays the given games in lockstep like playAutoGamesBatched, with each AI
+// plan adjusted by the game's point as league variants do
+template<class M>
+void playPolicyGamesBatched(const BasicGameConfig<M>& cfg, const vector<PolicyPoint>& grid, const PolicyGame* todo,
+                            size_t n, SuggestBatch& batch, GameResult* out)
+{
+    vector<BasicGame<M>> games;
+    games.reserve(n);
+    vector<MarketEvent> events(n);
+    vector<uint32_t> live(n);
+    BasicGameConfig<M> c = cfg;
+    for (size_t i = 0; i < n; ++i) {
+        c.advisor.learningRate = grid[todo[i].point].learningRate;
+        games.emplace_back(todo[i].seed, c);
+        out[i] = GameResult();
+        out[i].seed = todo[i].seed;
+        live[i] = (uint32_t)i;
+    }
+    for (int w = 1; w <= cfg.weeks && !live.empty(); ++w) {
+        batch.clear();
+        for (uint32_t i : live) {
+            events[i] = games[i].beginWeek();
+            batch.add(games[i].adviceRequest(events[i]));
+        }
+        const vector<Plan>& plans = batch.solve();
+        size_t kept = 0;
+        for (size_t j = 0; j < live.size(); ++j) {
+            uint32_t i = live[j];
+            const PolicyPoint& pt = grid[todo[i].point];
+            const Plan& p = plans[j];
+            Plan chosen{clampv(p.price + pt.priceShift, 1.0, 60.0), p.adSpend * pt.adScale,
+                        clampv((int)lround(p.production * pt.prodScale), 0, 200)};
+            const Snapshot& snap = games[i].resolveWeek(chosen, events[i]);
+            out[i].weeksPlayed = w;
+            out[i].unitsSold += snap.sold;
+            out[i].totalProfit += snap.profit;
+            if (games[i].bankrupt()) out[i].bankrupt = true;
+            else live[kept++] = i;
+        }
+        live.resize(kept);
+    }
+    for (size_t i = 0; i < n; ++i) out[i].finalCash = games[i].co.cash;
+}
+
+// All listed games on the pool, 64 in lockstep per task
+template<class M>
+vector<GameResult> playPolicyGames(const BasicGameConfig<M>& cfg, const vector<PolicyPoint>& grid,
+                                   const vector<PolicyGame>& todo, WorkerPool& pool)
+{
+    vector<GameResult> out(todo.size());
+    pool.parallelFor(todo.size(), 64, [&](size_t b, size_t e) {
+        thread_local SuggestBatch batch;
+        playPolicyGamesBatched(cfg, grid, todo.data() + b, e - b, batch, out.data() + b);
+    });
+    return out;
+}
+
+double pearson(const vector<double>& x, const vector<double>& y) {
+    const size_t n = x.size();
+    double mx = 0.0, my = 0.0;
+    for (size_t i = 0; i < n; ++i) { mx += x[i]; my += y[i]; }
+    mx /= n;
+    my /= n;
+    double sxy = 0.0, sxx = 0.0, syy = 0.0;
+    for (size_t i = 0; i < n; ++i) {
+        sxy += (x[i] - mx) * (y[i] - my);
+        sxx += (x[i] - mx) * (x[i] - mx);
+        syy += (y[i] - my) * (y[i] - my);
+    }
+    return sxx > 0.0 && syy > 0.0 ? sxy / sqrt(sxx * syy) : 0.0;
+}
+
+// Ranks from 1, ties share their average rank
+vector<double> ranks(const vector<double>& x) {
+    vector<size_t> order(x.size());
+    iota(order.begin(), order.end(), 0);
+    sort(order.begin(), order.end(), [&](size_t a, size_t b) { return x[a] < x[b]; });
+    vector<double> r(x.size());
+    for (size_t i = 0; i < order.size();) {
+        size_t j = i;
+        while (j < order.size() && x[order[j]] == x[order[i]]) ++j;
+        for (size_t k = i; k < j; ++k) r[order[k]] = 0.5 * (double)(i + j + 1);
+        i = j;
+    }
+    return r;
+}
+
+double spearman(const vector<double>& x, const vector<double>& y) { return pearson(ranks(x), ranks(y)); }
+
+int runMultiFidelity(int promote, int seeds, int sample, int cheapSeeds) {
+    WorkerPool pool;
+    vector<PolicyPoint> grid = defaultPolicyGrid();
+    const size_t n = grid.size();
+    promote = clampv(promote, 1, (int)n);
+    sample = clampv(sample, 3, (int)n);
+    seeds = max(2, seeds);
+    cheapSeeds = max(1, cheapSeeds);
+
+    BasicGameConfig<ExpectedMarket> cheapCfg;
+    cheapCfg.market.driftStd = 0.0;
+    GameConfig fullCfg;
+
+    // Screen every point at the cheap fidelity
+    vector<double> cheap(n, 0.0);
+    auto t0 = chrono::steady_clock::now();
+    vector<PolicyGame> todo;
+    for (size_t i = 0; i < n; ++i)
+        for (int s = 0; s < cheapSeeds; ++s) todo.push_back({(uint64_t)s + 1, (uint32_t)i});
+    vector<GameResult> played = playPolicyGames(cheapCfg, grid, todo, pool);
+    for (size_t k = 0; k < todo.size(); ++k) cheap[todo[k].point] += played[k].finalCash / cheapSeeds;
+    double screenSecs = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+
+    // Promote the top of the screen, plus a random sample and the unadjusted
+    // default for reference
+    vector<size_t> order(n);
+    iota(order.begin(), order.end(), 0);
+    sort(order.begin(), order.end(), [&](size_t a, size_t b) { return cheap[a] > cheap[b]; });
+    vector<size_t> promoted(order.begin(), order.begin() + promote);
+    vector<size_t> shuffled(n);
+    iota(shuffled.begin(), shuffled.end(), 0);
+    FastRng rng(125);
+    for (int i = 0; i < sample; ++i) swap(shuffled[i], shuffled[i + rng() % (n - i)]);
+    vector<size_t> sampled(shuffled.begin(), shuffled.begin() + sample);
+    size_t defaultPoint = n;
+    for (size_t i = 0; i < n; ++i)
+        if (grid[i].priceShift == 0.0 && grid[i].adScale == 1.0 && grid[i].prodScale == 1.0
+            && grid[i].learningRate == AdvisorConfig().learningRate)
+            defaultPoint = i;
+    if (defaultPoint == n) throw runtime_error("multi-fidelity: grid lacks the default point");
+
+    vector<size_t> full = promoted;
+    full.insert(full.end(), sampled.begin(), sampled.end());
+    full.push_back(defaultPoint);
+    sort(full.begin(), full.end());
+    full.erase(unique(full.begin(), full.end()), full.end());
+
+    vector<ResultSketch> sketch(n);
+    auto t1 = chrono::steady_clock::now();
+    todo.clear();
+    for (size_t i : full)
+        for (int s = 0; s < seeds; ++s) todo.push_back({(uint64_t)s + 1, (uint32_t)i});
+    played = playPolicyGames(fullCfg, grid, todo, pool);
+    for (size_t k = 0; k < todo.size(); ++k) sketch[todo[k].point].add(played[k]);
+    double fullSecs = chrono::duration<double>(chrono::steady_clock::now() - t1).count();
+    double perPoint = fullSecs / full.size();
+
+    auto fidelityPair = [&](const vector<size_t>& pts, vector<double>& x, vector<double>& y) {
+        x.clear();
+        y.clear();
+        for (size_t i : pts) { x.push_back(cheap[i]); y.push_back(sketch[i].mean); }
+    };
+    vector<double> cx, fx;
+    fidelityPair(sampled, cx, fx);
+    double rSample = pearson(cx, fx), rhoSample = spearman(cx, fx);
+    fidelityPair(promoted, cx, fx);
+    double rTop = pearson(cx, fx), rhoTop = spearman(cx, fx);
+
+    sort(promoted.begin(), promoted.end(), [&](size_t a, size_t b) { return sketch[a].mean > sketch[b].mean; });
+    size_t bestSampled = *max_element(sampled.begin(), sampled.end(),
+                                      [&](size_t a, size_t b) { return sketch[a].mean < sketch[b].mean; });
+    size_t beaten = 0;
+    for (size_t i : sampled) beaten += sketch[i].mean < sketch[promoted[0]].mean;
+
+    cout << fixed << setprecision(2);
+    cout << "Multi-fidelity screen of " << n << " strategy points, " << pool.size() << " threads\n";
+    cout << "  cheap (expected-value market, " << cheapSeeds << " seed" << (cheapSeeds > 1 ? "s" : "") << "): "
+         << screenSecs << " s, " << screenSecs / n * 1000.0 << " ms per point\n";
+    cout << "  full Monte Carlo (" << seeds << " seeds) on " << full.size() << " points: " << fullSecs << " s, "
+         << perPoint * 1000.0 << " ms per point; all " << n << " would take ~" << perPoint * n << " s\n";
+    cout << setprecision(3);
+    cout << "  fidelity correlation over " << sample << " random points: Pearson " << rSample << ", Spearman "
+         << rhoSample << "\n";
+    cout << "  among the " << promote << " promoted: Pearson " << rTop << ", Spearman " << rhoTop << "\n";
+    cout << setprecision(2);
+    cout << "  price+   ad x  prod x  learn rate   cheap $    full $  (95% CI)        bankrupt\n";
+    auto row = [&](const char* tag, size_t i) {
+        const PolicyPoint& p = grid[i];
+        const ResultSketch& sk = sketch[i];
+        double half = 1.96 * sk.stddev() / sqrt((double)sk.games);
+        cout << "  " << setw(6) << p.priceShift << setw(7) << p.adScale << setw(8) << p.prodScale << setw(11)
+             << setprecision(4) << p.learningRate << setprecision(2) << setw(10) << cheap[i] << setw(10) << sk.mean
+             << "  (+/- " << setw(7) << half << ")" << setw(8) << 100.0 * sk.bankruptcies / sk.games << "%  " << tag
+             << "\n";
+    };
+    for (int k = 0; k < min(5, promote); ++k) row(k == 0 ? "best promoted" : "", promoted[k]);
+    if (bestSampled != promoted[0]) row("best of random sample", bestSampled);
+    row("default", defaultPoint);
+    cout << "Best promoted point beats " << beaten << " of " << sample << " random points at full fidelity.\n";
+    return 0;
+}
+
+// ---------- Game Loop ----------
+int main(int argc, char** argv) {
+    ios::sync_with_stdio(false);
+    cin.tie(nullptr);
+
+    vector<string> args(argv + 1, argv + argc);
+    auto argInt = [&](size_t i, int def) { return i < args.size() ? stoi(args[i]) : def; };
+    if (!args.empty() && args[0] == "--supply-bench") return runSupplyBench(argInt(1, 10000), argInt(2, 52));
+    if (!args.empty() && args[0] == "--supply-game") return runSupplyGame(argInt(1, 2000));
+    if (!args.empty() && args[0] == "--live-bench") return runLiveBench(argInt(1, 20000));
+    if (args.size() >= 2 && args[0] == "--shm-publish") return runStreamPublisher(args[1], argInt(2, 10000));
+    if (args.size() >= 2 && args[0] == "--shm-tail") return runStreamTail(args[1], args.size() > 2 && args[2] == "games");
+    if (!args.empty() && args[0] == "--sweep-local")
+        return runSweepCoordinator(0, argInt(2, 20), argInt(3, 50), max(1, argInt(1, 4)));
+    if (!args.empty() && args[0] == "--coordinator") return runSweepCoordinator(argInt(1, 7400), argInt(2, 20), argInt(3, 50), 0);
+    if (args.size() >= 3 && args[0] == "--worker") return runSweepWorker(args[1], stoi(args[2]));
+    if (!args.empty() && args[0] == "--rooms-bench")
+        return runRoomsBench(argInt(1, 10000), argInt(2, 10), argInt(3, 3), argInt(4, 1000));
+    if (!args.empty() && args[0] == "--rooms-server")
+        return runRoomsServer(argInt(1, 7500), argInt(2, 100), argInt(3, 2), argInt(4, 5000));
+    if (!args.empty() && args[0] == "--leaderboard-bench") return runLeaderboardBench(argInt(1, 5000));
+    if (!args.empty() && args[0] == "--market-bench") return runMarketBench(argInt(1, 1000000));
+    if (!args.empty() && args[0] == "--batch") return runBatchSummary(argInt(1, 10000), argInt(2, 2000));
+    if (!args.empty() && args[0] == "--compare")
+        return runPairedComparison(argInt(1, 5000), args.size() > 2 ? stod(args[2]) : 0.0015,
+                                   args.size() > 3 ? stod(args[3]) : 0.003, argInt(4, 2000));
+    if (!args.empty() && args[0] == "--bootstrap-bench") return runBootstrapBench(argInt(1, 1000000), argInt(2, 10000));
+    if (!args.empty() && args[0] == "--multi-fidelity")
+        return runMultiFidelity(argInt(1, 32), argInt(2, 200), argInt(3, 64), argInt(4, 1));
+    if (!args.empty() && args[0] == "--math-check") return runMathCheck(argInt(1, 1000000), argInt(2, 2000));
+    if (!args.empty() && args[0] == "--recost")
+        return runRecost(args.size() > 1 && args[1] != "-" ? args[1] : "", args.size() > 2 ? stod(args[2]) : 9.0,
+                         args.size() > 3 ? stod(args[3]) : 1500.0, argInt(4, 20000));
+    if (!args.empty() && args[0] == "--jobs-bench") return runJobsBench(argInt(1, (int)max(1u, thread::hardware_concurrency())));
+    if (!args.empty() && args[0] == "--job-server")
+        return runJobServer(argInt(1, 7600), argInt(2, (int)max(1u, thread::hardware_concurrency())));
+    if (!args.empty() && args[0] == "--league") return runLeague(argInt(1, 64), argInt(2, 100), argInt(3, 256));
+    if (!args.empty() && args[0] == "--changepoints") return runChangePointBench(argInt(1, 2048), argInt(2, 52));
+    if (!args.empty() && args[0] == "--similar-weeks") return runSimilarWeeksBench(argInt(1, 1000000), argInt(2, 50));
+    if (!args.empty() && args[0] == "--advisor-server") return runAdvisorServer(argInt(1, 7600), argInt(2, 2));
+    if (args.size() >= 3 && args[0] == "--advisor-loadgen")
+        return runAdvisorLoadgen(args[1], stoi(args[2]), argInt(3, 8), argInt(4, 5), argInt(5, 100));
+    if (!args.empty() && args[0] == "--advisor-bench") return runAdvisorServiceBench(argInt(1, 8), argInt(2, 5), argInt(3, 100));
+    if (!args.empty() && args[0] == "--rcu-bench") return runPublishedAdvisorBench(argInt(1, 4), argInt(2, 3));
+    if (!args.empty() && args[0] == "--decision-bench")
+        return runDecisionLogBench(argInt(1, 20000), args.size() > 2 ? args[2] : "decisions.atlog");
+    if (args.size() >= 2 && args[0] == "--replay") return runReplay(args[1], argInt(2, 0), argInt(3, 1), argInt(4, 1000));
+    if (args.size() >= 2 && args[0] == "--bundle-build") return runBundleBuild(args[1], argInt(2, 1000000));
+    if (args.size() >= 2 && args[0] == "--bundle-open") return runBundleOpen(args[1]);
+    if (!args.empty() && args[0] == "--mcts-bench") return runMctsBench(argInt(1, 50), argInt(2, 30));
+    if (!args.empty() && args[0] == "--optimal") return runOptimalPolicy(argInt(1, 400));
+    if (!args.empty() && args[0] == "--advice-bench") return runAdviceBench(argInt(1, 2000), argInt(2, 256));
+    if (!args.empty() && args[0] == "--catalog") return runCatalogBench(argInt(1, 4000), argInt(2, 52));
+    if (!args.empty() && args[0] == "--sobol") return runSobolAnalysis(argInt(1, 256), argInt(2, 1));
+    if (args.size() >= 2 && args[0] == "--trace") return runTraceMonteCarlo(args[1], argInt(2, 100000), argInt(3, 32));
+
+    cout << "==============================\n";
+    cout << "  AI TYCOON – The Business Brain\n";
+    cout << "==============================\n\n";
+    cout << "Goal: Grow profits over 12 turns. Your AI advisor learns and suggests a plan each week.\n";
+    cout << "You sell a single product. Unit production cost = $8. Fixed weekly overhead = $1200.\n";
+    cout << "You begin with 40 units in inventory and $20,000 cash.\n\n";
+
+    Game game;
+    Company& co = game.co;
+
+    int weeks = 12;
+
+    // --record <file>: keep the seed and decisions so the game can be replayed
+    unique_ptr<DecisionLogWriter> recorder;
+    if (args.size() >= 2 && args[0] == "--record") {
+        recorder = make_unique<DecisionLogWriter>(GameConfig());
+        recorder->beginGame(12345);
+    }
+
+    // --mcts [ms]: plans come from the tree-search advisor instead
+    unique_ptr<WorkerPool> mctsPool;
+    unique_ptr<MctsAdvisor> mcts;
+    if (!args.empty() && args[0] == "--mcts") {
+        MctsConfig mc;
+        mc.budgetMs = argInt(1, 30);
+        mctsPool = make_unique<WorkerPool>();
+        mcts = make_unique<MctsAdvisor>(*mctsPool, mc);
+    }
+
+    for (int week = 1; week <= weeks; ++week) {
+        cout << "\n==== Week " << week << " ====\n";
+        MarketEvent ev = game.beginWeek();
+        cout << "Market event: " << ev.name << "\n";
+
+        // AI suggestion
+        Plan plan = mcts ? mcts->suggest(game, ev, weeks) : game.advise(ev);
+        cout << fixed << setprecision(2);
+        cout << "AI suggests -> Price: $" << plan.price
+             << " | Ad: $" << plan.adSpend
+             << " | Produce: " << plan.production << " units\n";
+        game.ai.printModel();
+
+        // Player choice
+        cout << "Accept AI plan? (y/n) ";
+        string yn; getline(cin, yn);
+        if (yn.size() == 0) { yn = "y"; }
+        Plan chosen = plan;
+        if (yn[0] == 'n' || yn[0] == 'N') {
+            cout << "Enter your Price [$9..$40]: ";
+            string s; getline(cin, s);
+            if (!s.empty()) chosen.price = clampv(stod(s), 9.0, 40.0);
+
+            cout << "Enter your Ad Spend [$0..$10000]: ";
+            getline(cin, s);
+            if (!s.empty()) chosen.adSpend = clampv(stod(s), 0.0, 10000.0);
+
+            cout << "Enter your Production [0..200]: ";
+            getline(cin, s);
+            if (!s.empty()) chosen.production = (int)clampv(stoi(s), 0, 200);
+        }
+
+        if (recorder) recorder->record(!mcts && yn[0] != 'n' && yn[0] != 'N', chosen);
+        const Snapshot& snap = game.resolveWeek(chosen, ev);
+
+        // HUD
+        cout << fixed << setprecision(2);
+        cout << "\n— Results —\n";
+        cout << "Sold: " << snap.sold << " units | Revenue: $" << snap.revenue << "\n";
+        cout << "Costs: $" << snap.cost << " | Profit: $" << snap.profit << "\n";
+        cout << "End Inventory: " << co.inventory << " | Cash: $" << co.cash << "\n";
+        cout << "Market baseline (hidden true): " << game.mk.baseDemand
+             << " | Your inferred proxy: " << game.baseProxy << "\n";
+
+        if (game.bankrupt()) {
+            cout << "\nYou ran out of cash. Game over early.\n";
+            break;
+        }
+    }
+
+    if (recorder) {
+        recorder->endGame();
+        recorder->save(args[1]);
     }
 
     // Post-game summary